@@ -0,0 +1,12 @@
+// Flags for bcachestat().
+#define BCACHE_RESET 1  // clear the counts
+#define BCACHE_DROP  2  // first give back all unused buffers
+
+// Buffer cache statistics, as reported by bcachestat().
+struct bcachestat {
+  uint64 hits;       // bread()s that found the block cached
+  uint64 misses;     // bread()s that had to recycle or add a buffer
+  uint64 shrunk;     // buffers given back to kalloc() under memory pressure
+  int nbuf;          // buffers in the cache now
+  int maxbuf;        // most buffers the cache may grow to
+};
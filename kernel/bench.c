@@ -0,0 +1,209 @@
+// Kernel self-benchmarks.
+// Run on demand through the kbench() system call;
+// results are printed on the console.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "defs.h"
+#include "kbench.h"
+
+#define BENCH_NPAGE   256  // pages touched per round (1 MiB)
+#define BENCH_ROUNDS  16
+
+// Print throughput for nbytes processed in dt ticks of the time
+// CSR and dc cycles.
+static void
+report(char *name, uint64 nbytes, uint64 dt, uint64 dc)
+{
+  uint64 bpc;
+
+  if(dt == 0)
+    dt = 1;
+  if(dc == 0)
+    dc = 1;
+  bpc = nbytes * 100 / dc;  // bytes/cycle, in hundredths
+  printf("kbench %s: %d KiB in %d us, %d MiB/s, %d.%d%d bytes/cycle\n", name,
+         (int)(nbytes / 1024), (int)(dt * 1000000 / TIMEFREQ),
+         (int)((nbytes * TIMEFREQ / dt) >> 20),
+         (int)(bpc / 100), (int)(bpc / 10 % 10), (int)(bpc % 10));
+}
+
+// Allocate up to BENCH_NPAGE pages into pg[].
+// Returns the number allocated.
+static int
+getpages(char **pg)
+{
+  int n;
+
+  for(n = 0; n < BENCH_NPAGE; n++){
+    if((pg[n] = kalloc()) == 0)
+      break;
+  }
+  return n;
+}
+
+// Copy pages scattered across the kernel's direct map, so that
+// every copy touches translations the TLB has probably dropped.
+// Build with SUPERPGFLG=OFF to compare against 4 KiB mappings.
+static int
+bench_memmove(void)
+{
+  char **pg;
+  int i, n, r;
+  uint64 t0, t1, c0, c1;
+
+  if((pg = (char**)kalloc()) == 0)
+    return -1;
+  if((n = getpages(pg)) < 2)
+    goto out;
+
+  t0 = r_time();
+  c0 = r_cycle();
+  for(r = 0; r < BENCH_ROUNDS; r++)
+    for(i = 0; i < n; i++)
+      memmove(pg[i], pg[(i + n/2) % n], PGSIZE);
+  c1 = r_cycle();
+  t1 = r_time();
+  report("memmove", (uint64)BENCH_ROUNDS * n * PGSIZE, t1 - t0, c1 - c0);
+
+  // short, unaligned copies, as for path names and
+  // partial blocks.
+  t0 = r_time();
+  c0 = r_cycle();
+  for(r = 0; r < BENCH_ROUNDS; r++)
+    for(i = 0; i < n; i++)
+      for(int off = 0; off + 200 <= PGSIZE; off += 200)
+        memmove(pg[i] + off + 3, pg[(i + n/2) % n] + off + 1, 100);
+  c1 = r_cycle();
+  t1 = r_time();
+  report("memmove-short", (uint64)BENCH_ROUNDS * n * (PGSIZE/200) * 100,
+         t1 - t0, c1 - c0);
+
+ out:
+  for(i = 0; i < n; i++)
+    kfree(pg[i]);
+  kfree((char*)pg);
+  return n < 2 ? -1 : 0;
+}
+
+// Zero whole pages, as kzalloc() and uvmalloc() do.
+static int
+bench_memset(void)
+{
+  char **pg;
+  int i, n, r;
+  uint64 t0, t1, c0, c1;
+
+  if((pg = (char**)kalloc()) == 0)
+    return -1;
+  if((n = getpages(pg)) < 1)
+    goto out;
+
+  t0 = r_time();
+  c0 = r_cycle();
+  for(r = 0; r < BENCH_ROUNDS; r++)
+    for(i = 0; i < n; i++)
+      memset(pg[i], 0, PGSIZE);
+  c1 = r_cycle();
+  t1 = r_time();
+  report("memset", (uint64)BENCH_ROUNDS * n * PGSIZE, t1 - t0, c1 - c0);
+
+ out:
+  for(i = 0; i < n; i++)
+    kfree(pg[i]);
+  kfree((char*)pg);
+  return n < 1 ? -1 : 0;
+}
+
+// Compare pairs of equal pages, the worst case for memcmp().
+static int
+bench_memcmp(void)
+{
+  char **pg;
+  int i, n, r, bad;
+  uint64 t0, t1, c0, c1;
+
+  if((pg = (char**)kalloc()) == 0)
+    return -1;
+  if((n = getpages(pg)) < 2)
+    goto out;
+  for(i = 0; i < n; i++)
+    memset(pg[i], 0x5a, PGSIZE);
+
+  bad = 0;
+  t0 = r_time();
+  c0 = r_cycle();
+  for(r = 0; r < BENCH_ROUNDS; r++)
+    for(i = 0; i < n; i++)
+      bad |= memcmp(pg[i], pg[(i + n/2) % n], PGSIZE);
+  c1 = r_cycle();
+  t1 = r_time();
+  if(bad)
+    printf("kbench memcmp: equal pages compared unequal\n");
+  report("memcmp", (uint64)BENCH_ROUNDS * n * PGSIZE, t1 - t0, c1 - c0);
+
+ out:
+  for(i = 0; i < n; i++)
+    kfree(pg[i]);
+  kfree((char*)pg);
+  return n < 2 ? -1 : 0;
+}
+
+int
+kbench(int which)
+{
+  switch(which){
+  case KBENCH_MEMMOVE:
+    return bench_memmove();
+  case KBENCH_MEMSET:
+    return bench_memset();
+  case KBENCH_MEMCMP:
+    return bench_memcmp();
+  }
+  return -1;
+}
+
+// One lock of each kind for lockbench(), shared by every
+// process running it. Not counted by lockstat().
+static struct spinlock benchlocks[] = {
+  [LOCK_TAS]    { .kind = LOCK_TAS,    .name = "bench-tas" },
+  [LOCK_TICKET] { .kind = LOCK_TICKET, .name = "bench-ticket" },
+  [LOCK_MCS]    { .kind = LOCK_MCS,    .name = "bench-mcs" },
+};
+static volatile uint64 benchcount;
+
+// Take and release the benchmark lock of the given kind n
+// times, doing a little work while holding it, and add the
+// cycles each acquire() took to hist[0..LOCKBENCH_NHIST-1].
+// Run in several processes at once to see contention.
+// Sets *dt to the elapsed time in ticks of the time CSR.
+// Returns 0, or -1 for a bad kind or count.
+int
+lockbench(int kind, int n, uint64 *hist, uint64 *dt)
+{
+  struct spinlock *lk;
+  uint64 t0, c0, c;
+  int i, b;
+
+  if(kind < 0 || kind >= NELEM(benchlocks) || n < 0)
+    return -1;
+  lk = &benchlocks[kind];
+
+  t0 = r_time();
+  for(i = 0; i < n; i++){
+    c0 = r_cycle();
+    acquire(lk);
+    c = r_cycle() - c0;
+    for(int j = 0; j < 8; j++)
+      benchcount++;
+    release(lk);
+    for(b = 0; b < LOCKBENCH_NHIST-1 && (c >> (b+1)) != 0; b++)
+      ;
+    hist[b]++;
+  }
+  *dt = r_time() - t0;
+  return 0;
+}
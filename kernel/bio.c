@@ -1,91 +1,316 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
+// The buffer cache is a hash table of buf structures holding
 // cached copies of disk block contents.  Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
 //
 // Interface:
 // * To get a buffer for a particular disk block, call bread.
-// * After changing buffer data, call bwrite to write it to disk.
+// * After changing buffer data, call bwrite to write it to disk,
+//     or bawrite to start writing several buffers and bwait
+//     to wait for each.
 // * When done with the buffer, call brelse.
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
 //     so do not keep them longer than necessary.
+//
+// Each buffer sits in the bucket its (dev, blockno) hashes to,
+// and each bucket has its own lock, so lookups of different
+// blocks rarely contend. bcache.lock serializes misses, so that
+// two processes missing on the same block don't both bring it in.
+//
+// Buffers live three to a page from kalloc(). A miss takes a
+// buffer from the free list, or adds a page of buffers while
+// the cache is smaller than 1/BCACHEFRAC of RAM, or else
+// recycles an unused buffer chosen by a clock sweep over all
+// buffers. When kalloc() runs out of memory it calls bshrink()
+// to give back pages whose buffers are all unused.
 
 
 #include "types.h"
 #include "param.h"
+#include "memlayout.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "riscv.h"
 #include "defs.h"
+#include "proc.h"
 #include "fs.h"
 #include "buf.h"
+#include "bcachestat.h"
 
-struct {
+#define NBUCKET 251
+
+// buffers per page
+#define BPP ((PGSIZE - sizeof(void*)) / sizeof(struct buf))
+
+struct bufpage {
+  struct bufpage *next;
+  struct buf buf[BPP];
+};
+
+struct bucket {
   struct spinlock lock;
-  struct buf buf[NBUF];
+  struct buf *head;
+};
+
+struct {
+  struct spinlock lock;  // held while adding, recycling or removing buffers
+  struct bucket bucket[NBUCKET];
+  struct buf *free;      // buffers holding no block; dev is 0
+  struct bufpage *pages;
+  int npage;
+  int maxpage;
 
-  // Linked list of all buffers, through prev/next.
-  // Sorted by how recently the buffer was used.
-  // head.next is most recent, head.prev is least.
-  struct buf head;
+  // clock hand: the next buffer to consider recycling
+  struct bufpage *hand;
+  int handi;
+
+  uint64 hits;
+  uint64 misses;
+  uint64 shrunk;
 } bcache;
 
+static struct bucket*
+bhash(uint dev, uint blockno)
+{
+  return &bcache.bucket[(dev * 31 + blockno) % NBUCKET];
+}
+
+static void
+blink(struct buf **head, struct buf *b)
+{
+  b->prev = 0;
+  b->next = *head;
+  if(*head)
+    (*head)->prev = b;
+  *head = b;
+}
+
+static void
+bunlink(struct buf **head, struct buf *b)
+{
+  if(b->prev)
+    b->prev->next = b->next;
+  else
+    *head = b->next;
+  if(b->next)
+    b->next->prev = b->prev;
+}
+
 void
 binit(void)
 {
-  struct buf *b;
+  struct bucket *bk;
 
   initlock(&bcache.lock, "bcache");
+  for(bk = bcache.bucket; bk < &bcache.bucket[NBUCKET]; bk++)
+    initlock(&bk->lock, "bcache.bucket");
+  bcache.maxpage = (PHYSTOP - KERNBASE) / PGSIZE / BCACHEFRAC;
+}
 
-  // Create linked list of buffers
-  bcache.head.prev = &bcache.head;
-  bcache.head.next = &bcache.head;
-  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
+// Look for the block in bucket bk, whose lock must be held.
+// If found, take a reference to it.
+static struct buf*
+bfind(struct bucket *bk, uint dev, uint blockno)
+{
+  struct buf *b;
+
+  for(b = bk->head; b; b = b->next){
+    if(b->dev == dev && b->blockno == blockno){
+      b->refcnt++;
+      b->used = 1;
+      return b;
+    }
+  }
+  return 0;
+}
+
+// Add a page of buffers to the free list, if the cache
+// may grow and there is memory for it.
+// Caller must hold bcache.lock.
+static void
+bgrow(void)
+{
+  struct bufpage *pg;
+  struct buf *b;
+
+  if(bcache.npage >= bcache.maxpage || (pg = kalloc()) == 0)
+    return;
+  for(b = pg->buf; b < &pg->buf[BPP]; b++){
     initsleeplock(&b->lock, "buffer");
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+    b->dev = 0;
+    b->refcnt = 0;
+    blink(&bcache.free, b);
+  }
+  pg->next = bcache.pages;
+  bcache.pages = pg;
+  bcache.npage++;
+}
+
+// Find an unused buffer to recycle for a block in bucket bk,
+// sweeping the clock hand over all buffers: a buffer used
+// since the hand last passed gets a second chance. Unlinks
+// the buffer from its bucket.
+// Caller must hold bcache.lock and bk->lock. Nobody else
+// holds two bucket locks, so taking another cannot deadlock.
+static struct buf*
+bclock(struct bucket *bk)
+{
+  struct bucket *obk;
+  struct buf *b;
+  int n;
+
+  for(n = 0; n < 2 * bcache.npage * BPP; n++){
+    if(bcache.hand == 0){
+      bcache.hand = bcache.pages;
+      bcache.handi = 0;
+    }
+    b = &bcache.hand->buf[bcache.handi];
+    if(++bcache.handi == BPP){
+      bcache.hand = bcache.hand->next;
+      bcache.handi = 0;
+    }
+
+    obk = bhash(b->dev, b->blockno);
+    if(obk != bk)
+      acquire(&obk->lock);
+    if(b->refcnt == 0 && !b->used){
+      bunlink(&obk->head, b);
+      if(obk != bk)
+        release(&obk->lock);
+      return b;
+    }
+    b->used = 0;
+    if(obk != bk)
+      release(&obk->lock);
   }
+  return 0;
 }
 
 // Look through buffer cache for block on device dev.
 // If not found, allocate a buffer.
 // In either case, return locked buffer.
+// If ahead is set and the block is cached, or there is no
+// buffer free for it, return 0 instead: read-ahead never
+// waits for a buffer, and is only a hint, so it may fail.
 static struct buf*
-bget(uint dev, uint blockno)
+bget(uint dev, uint blockno, int ahead)
 {
+  struct bucket *bk;
   struct buf *b;
 
-  acquire(&bcache.lock);
+  bk = bhash(dev, blockno);
 
   // Is the block already cached?
-  for(b = bcache.head.next; b != &bcache.head; b = b->next){
-    if(b->dev == dev && b->blockno == blockno){
-      b->refcnt++;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
-    }
+  acquire(&bk->lock);
+  b = bfind(bk, dev, blockno);
+  if(b && ahead)
+    b->refcnt--;
+  release(&bk->lock);
+  if(b){
+    if(ahead)
+      return 0;
+    __sync_fetch_and_add(&bcache.hits, 1);
+    acquiresleep(&b->lock);
+    return b;
   }
 
-  // Not cached.
-  // Recycle the least recently used (LRU) unused buffer.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->valid = 0;
-      b->refcnt = 1;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
+  // Not cached. Look again, now that nobody else can be
+  // adding a block, in case another process just added it.
+  acquire(&bcache.lock);
+  acquire(&bk->lock);
+  if((b = bfind(bk, dev, blockno)) != 0){
+    if(ahead)
+      b->refcnt--;
+    release(&bk->lock);
+    release(&bcache.lock);
+    if(ahead)
+      return 0;
+    __sync_fetch_and_add(&bcache.hits, 1);
+    acquiresleep(&b->lock);
+    return b;
+  }
+  __sync_fetch_and_add(&bcache.misses, 1);
+
+  if(bcache.free == 0)
+    bgrow();
+  if((b = bcache.free) != 0)
+    bunlink(&bcache.free, b);
+  else if((b = bclock(bk)) == 0){
+    if(!ahead)
+      panic("bget: no buffers");
+    release(&bk->lock);
+    release(&bcache.lock);
+    return 0;
+  }
+
+  b->dev = dev;
+  b->blockno = blockno;
+  b->valid = 0;
+  b->refcnt = 1;
+  b->used = 1;
+  blink(&bk->head, b);
+  release(&bk->lock);
+  release(&bcache.lock);
+  acquiresleep(&b->lock);
+  return b;
+}
+
+// Give back to kalloc() up to n pages whose buffers are
+// all unused. Called by kalloc() when it runs out of memory.
+// Returns the number of pages freed.
+int
+bshrink(int n)
+{
+  struct bufpage *pg, **pp;
+  struct bucket *bk;
+  struct buf *b;
+  int busy, freed;
+
+  // kalloc() calls from bgrow() (or from an interrupt taken
+  // while this CPU is in the middle of a miss) can't wait for
+  // bcache.lock.
+  if(bcache.npage == 0 || holding(&bcache.lock))
+    return 0;
+
+  acquire(&bcache.lock);
+  freed = 0;
+  for(pp = &bcache.pages; (pg = *pp) != 0 && freed < n; ){
+    // move the page's unused buffers to the free list.
+    busy = 0;
+    for(b = pg->buf; b < &pg->buf[BPP]; b++){
+      if(b->dev == 0)
+        continue;
+      bk = bhash(b->dev, b->blockno);
+      acquire(&bk->lock);
+      if(b->refcnt == 0){
+        bunlink(&bk->head, b);
+        b->dev = 0;
+        blink(&bcache.free, b);
+      } else {
+        busy = 1;
+      }
+      release(&bk->lock);
+    }
+    if(busy){
+      pp = &pg->next;
+      continue;
     }
+
+    for(b = pg->buf; b < &pg->buf[BPP]; b++)
+      bunlink(&bcache.free, b);
+    *pp = pg->next;
+    if(bcache.hand == pg)
+      bcache.hand = 0;
+    bcache.npage--;
+    bcache.shrunk += BPP;
+    kfree(pg);
+    freed++;
   }
-  panic("bget: no buffers");
+  release(&bcache.lock);
+  return freed;
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -94,60 +319,160 @@ bread(uint dev, uint blockno)
 {
   struct buf *b;
 
-  b = bget(dev, blockno);
+  b = bget(dev, blockno, 0);
   if(!b->valid) {
-    virtio_disk_rw(b, 0);
+    virtio_disk_start(&b, 1, 0, 0);
+    virtio_disk_wait(b);
     b->valid = 1;
   }
   return b;
 }
 
+// Called by virtio_disk_intr() when a read started by
+// breadahead() finishes. Releases the buffer on behalf of
+// the process that started the read.
+static void
+breadaheaddone(struct buf *b)
+{
+  struct bucket *bk;
+
+  b->valid = 1;
+  releasesleep(&b->lock);
+
+  bk = bhash(b->dev, b->blockno);
+  acquire(&bk->lock);
+  b->refcnt--;
+  release(&bk->lock);
+}
+
+// Sort bs[0..n-1] by block number, so that the disk driver
+// can combine runs of consecutive blocks into one request.
+static void
+bsort(struct buf **bs, int n)
+{
+  struct buf *b;
+  int i, j;
+
+  for(i = 1; i < n; i++){
+    b = bs[i];
+    for(j = i; j > 0 && bs[j-1]->blockno > b->blockno; j--)
+      bs[j] = bs[j-1];
+    bs[j] = b;
+  }
+}
+
+// Start reading the n indicated blocks into the cache,
+// except those there already and those there is no buffer
+// for, and return without waiting.
+// A later bread() of one of the blocks waits for its read
+// to finish.
+void
+breadahead(uint dev, uint *blocknos, int n)
+{
+  struct buf *bs[NREADAHEAD];
+  int i, nb;
+
+  if(n > NREADAHEAD)
+    panic("breadahead");
+  nb = 0;
+  for(i = 0; i < n; i++)
+    if((bs[nb] = bget(dev, blocknos[i], 1)) != 0)
+      nb++;
+  bsort(bs, nb);
+  virtio_disk_start(bs, nb, 0, breadaheaddone);
+}
+
 // Write b's contents to disk.  Must be locked.
 void
 bwrite(struct buf *b)
 {
   if(!holdingsleep(&b->lock))
     panic("bwrite");
-  virtio_disk_rw(b, 1);
+  virtio_disk_start(&b, 1, 1, 0);
+  virtio_disk_wait(b);
+}
+
+// Start writing the contents of the n buffers in bs[] to
+// disk, without waiting for the writes to finish. Sorts
+// bs[] by block number, so that runs of consecutive blocks
+// go to the disk as single requests. The buffers must be
+// locked, and stay locked until bwait() returns, so that
+// nobody changes b->data while the device reads it.
+void
+bawrite(struct buf **bs, int n)
+{
+  for(int i = 0; i < n; i++)
+    if(!holdingsleep(&bs[i]->lock))
+      panic("bawrite");
+  bsort(bs, n);
+  virtio_disk_start(bs, n, 1, 0);
+}
+
+// Wait for a write started by bawrite() to finish.
+void
+bwait(struct buf *b)
+{
+  virtio_disk_wait(b);
 }
 
 // Release a locked buffer.
-// Move to the head of the most-recently-used list.
 void
 brelse(struct buf *b)
 {
+  struct bucket *bk;
+
   if(!holdingsleep(&b->lock))
     panic("brelse");
 
   releasesleep(&b->lock);
 
-  acquire(&bcache.lock);
+  bk = bhash(b->dev, b->blockno);
+  acquire(&bk->lock);
   b->refcnt--;
-  if (b->refcnt == 0) {
-    // no one is waiting for it.
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
-  }
-  
-  release(&bcache.lock);
+  release(&bk->lock);
 }
 
 void
 bpin(struct buf *b) {
-  acquire(&bcache.lock);
+  struct bucket *bk = bhash(b->dev, b->blockno);
+
+  acquire(&bk->lock);
   b->refcnt++;
-  release(&bcache.lock);
+  release(&bk->lock);
 }
 
 void
 bunpin(struct buf *b) {
-  acquire(&bcache.lock);
+  struct bucket *bk = bhash(b->dev, b->blockno);
+
+  acquire(&bk->lock);
   b->refcnt--;
-  release(&bcache.lock);
+  release(&bk->lock);
 }
 
+// Copy the cache's hit and miss counts and size to user
+// address addr. flags is a combination of BCACHE_RESET and
+// BCACHE_DROP; dropping the cache lets a benchmark measure
+// reads that go to the disk.
+int
+bcachestat(uint64 addr, int flags)
+{
+  struct bcachestat st;
 
+  if(flags & BCACHE_DROP)
+    bshrink(bcache.npage);
+  memset(&st, 0, sizeof(st));
+  acquire(&bcache.lock);
+  st.hits = bcache.hits;
+  st.misses = bcache.misses;
+  st.shrunk = bcache.shrunk;
+  st.nbuf = bcache.npage * BPP;
+  st.maxbuf = bcache.maxpage * BPP;
+  if(flags & BCACHE_RESET){
+    bcache.hits = 0;
+    bcache.misses = 0;
+    bcache.shrunk = 0;
+  }
+  release(&bcache.lock);
+  return copyout(myproc()->pagetable, addr, (char*)&st, sizeof(st));
+}
@@ -5,8 +5,10 @@ struct buf {
   uint blockno;
   struct sleeplock lock;
   uint refcnt;
-  struct buf *prev; // LRU cache list
+  int used;         // looked up since the clock hand last passed?
+  struct buf *prev; // hash bucket list
   struct buf *next;
+  struct buf *ionext; // next buffer in the same disk request
   uchar data[BSIZE];
 };
 
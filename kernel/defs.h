@@ -2,20 +2,33 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct kmem_cache;
 struct pipe;
 struct proc;
 struct spinlock;
 struct sleeplock;
+struct rwsleeplock;
+struct rwspinlock;
 struct stat;
 struct superblock;
+struct ushared;
+
+// bench.c
+int             kbench(int);
+int             lockbench(int, int, uint64*, uint64*);
 
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
+void            breadahead(uint, uint*, int);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
+void            bawrite(struct buf**, int);
+void            bwait(struct buf*);
 void            bpin(struct buf*);
 void            bunpin(struct buf*);
+int             bshrink(int);
+int             bcachestat(uint64, int);
 
 // console.c
 void            consoleinit(void);
@@ -44,7 +57,10 @@ void            iinit();
 void            ilock(struct inode*);
 void            iput(struct inode*);
 void            iunlock(struct inode*);
+void            ilockshared(struct inode*);
+void            iunlockshared(struct inode*);
 void            iunlockput(struct inode*);
+void            iunreserve(struct inode*);
 void            iupdate(struct inode*);
 int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
@@ -61,18 +77,42 @@ void            ramdiskrw(struct buf*);
 
 // kalloc.c
 void*           kalloc(void);
+void*           kalloc_pages(int);
+void*           kzalloc(void);
 void            kfree(void *);
+void            kfree_pages(void *, int);
 void            kinit(void);
+int             kzeroidle(void);
+int             kmeminfo(int*, int);
+
+// slab.c
+void            kmem_cache_init(struct kmem_cache*, char*, uint);
+void*           kmem_cache_alloc(struct kmem_cache*);
+void            kmem_cache_free(struct kmem_cache*, void*);
+int             kmem_cache_reap(void);
 
 // log.c
 void            initlog(int, struct superblock*);
 void            log_write(struct buf*);
 void            begin_op(void);
+void            begin_opn(int);
+int             log_maxwrite(void);
+int             log_writeblocks(int);
 void            end_op(void);
 
+// mmap.c
+uint64          mmap(uint64, int, int, struct file*, uint);
+uint64          mmapbase(struct proc*);
+int             munmap(uint64, uint64);
+void            mmapexit(void);
+int             mmapfault(pagetable_t, uint64, int);
+void            mmaptouch(uint64, uint64, int);
+int             mmapcopy(struct proc*, struct proc*);
+
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
+void            pipeinit(void);
 int             piperead(struct pipe*, uint64, int);
 int             pipewrite(struct pipe*, uint64, int);
 
@@ -81,6 +121,11 @@ void            printf(char*, ...);
 void            panic(char*) __attribute__((noreturn));
 void            printfinit(void);
 
+// prof.c
+void            profinit(void);
+int             proftick(void);
+int             prof(int, uint64, int);
+
 // proc.c
 int             cpuid(void);
 void            exit(int);
@@ -111,6 +156,8 @@ void            remove_from_list(struct proc *head, struct proc *p);
 void            print_global_list(struct proc *head);
 int             cpu_process_count(int cpu_num);
 int             get_min_cpu();
+void            runq_add(int cpu, int delta);
+extern struct ushared *ushared;
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -119,15 +166,28 @@ void            swtch(struct context*, struct context*);
 void            acquire(struct spinlock*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
+void            initlock_kind(struct spinlock*, char*, int);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
+int             lockstat(uint64, int, int);
+void            initrwlock(struct rwspinlock*, char*);
+void            acquireread(struct rwspinlock*);
+void            releaseread(struct rwspinlock*);
+void            acquirewrite(struct rwspinlock*);
+void            releasewrite(struct rwspinlock*);
 
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
+void            initrwsleeplock(struct rwsleeplock*, char*);
+void            acquirereadsleep(struct rwsleeplock*);
+void            releasereadsleep(struct rwsleeplock*);
+void            acquirewritesleep(struct rwsleeplock*);
+void            releasewritesleep(struct rwsleeplock*);
+int             holdingwritesleep(struct rwsleeplock*);
 
 // string.c
 int             memcmp(const void*, const void*, uint);
@@ -145,6 +205,8 @@ int             argaddr(int, uint64 *);
 int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
+uint64          syscallring(int, uint64*);
+int             scstats(uint64, int, int);
 
 // trap.c
 extern uint     ticks;
@@ -160,6 +222,11 @@ void            uartputc(int);
 void            uartputc_sync(int);
 int             uartgetc(void);
 
+// uring.c
+uint64          uringsetup(void);
+int             uringenter(int);
+void            uringfree(struct proc*);
+
 // vm.c
 void            kvminit(void);
 void            kvminithart(void);
@@ -173,6 +240,9 @@ int             uvmcopy(pagetable_t, pagetable_t, uint64);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
+pte_t*          walk(pagetable_t, uint64, int);
+void            uvmflush(pagetable_t);
+void            uvmmirror(pagetable_t);
 uint64          walkaddr(pagetable_t, uint64);
 int             copyout(pagetable_t, uint64, char *, uint64);
 int             copyin(pagetable_t, char *, uint64, uint64);
@@ -186,7 +256,8 @@ void            plic_complete(int);
 
 // virtio_disk.c
 void            virtio_disk_init(void);
-void            virtio_disk_rw(struct buf *, int);
+void            virtio_disk_start(struct buf **, int, int, void (*)(struct buf*));
+void            virtio_disk_wait(struct buf *);
 void            virtio_disk_intr(void);
 
 // number of elements in fixed-size array
@@ -109,8 +109,12 @@ exec(char *path, char **argv)
   safestrcpy(p->name, last, sizeof(p->name));
     
   // Commit to the user image.
+  mmapexit();
+  uringfree(p);
   oldpagetable = p->pagetable;
   p->pagetable = pagetable;
+  uvmflush(pagetable);
+  uvmmirror(pagetable);
   p->sz = sz;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
@@ -18,15 +18,20 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
-  struct sleeplock lock; // protects everything below here
+  struct inode *next; // itable list
+  struct inode *prev;
+  struct rwsleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
+  uint ralast;        // read-ahead: last block readi() read
+  uint rahead;        // read-ahead: first block not yet read ahead
 
   short type;         // copy of disk inode
   short major;
   short minor;
   short nlink;
   uint size;
-  uint addrs[NDIRECT+1];
+  struct extent ext[NEXTENT];
+  uint dindirect;
 };
 
 // map major device number to device functions.
@@ -20,6 +20,7 @@
 #include "fs.h"
 #include "buf.h"
 #include "file.h"
+#include "slab.h"
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 // there should be one superblock per disk device, but we run with
@@ -37,6 +38,8 @@ readsb(int dev, struct superblock *sb)
   brelse(bp);
 }
 
+static void bsuminit(int dev);
+
 // Init fs
 void
 fsinit(int dev) {
@@ -44,6 +47,7 @@ fsinit(int dev) {
   if(sb.magic != FSMAGIC)
     panic("invalid file system");
   initlog(dev, &sb);
+  bsuminit(dev);
 }
 
 // Zero a block.
@@ -59,30 +63,242 @@ bzero(int dev, int bno)
 }
 
 // Blocks.
+//
+// balloc() avoids scanning the bitmap from the start with a
+// summary kept in memory: how many free blocks each bitmap
+// block describes, and a cursor where the last allocation
+// left off. It claims a free block from the first bitmap
+// block at or after the cursor that has one, then scans
+// that block's bitmap from the cursor a 64-bit word at a
+// time. Counts are claimed before the bitmap block is
+// read, so the scan always finds a free bit. A caller that
+// wants its block next to one it already has passes that
+// neighbour as a goal, which stands in for the cursor.
+//
+// So that files written at the same time do not interleave
+// on disk, a block allocated for a growing file comes with
+// a window of up to NPREALLOC free blocks right after it,
+// set aside for the file's next blocks. Windows live only
+// in memory: their blocks stay free in the bitmap, but are
+// not counted in the summary and other allocations skip
+// them. A window is given back when the file is closed for
+// writing or leaves the inode table, when the file's next
+// block is not the window's first, and when the disk would
+// otherwise be full.
+
+#define NRESV 16  // windows set aside at once
+
+// Free blocks [start, start+len) set aside for ip, all
+// described by one bitmap block.
+struct resv {
+  struct inode *ip;
+  uint start;
+  uint len;
+};
 
-// Allocate a zeroed disk block.
-static uint
-balloc(uint dev)
+struct {
+  struct spinlock lock;
+  int nbmap;     // bitmap blocks
+  int *nfree;    // free blocks, outside windows, per bitmap block
+  uint cursor;   // block number to try first
+  struct resv resv[NRESV];
+} bsum;
+
+// Number of blocks bitmap block i describes.
+static int
+bmapbits(int i)
+{
+  return sb.size - i*BPB < BPB ? sb.size - i*BPB : BPB;
+}
+
+// Count the free blocks in each bitmap block.
+// Called once the log has been recovered.
+static void
+bsuminit(int dev)
 {
-  int b, bi, m;
   struct buf *bp;
+  int i, bi;
+
+  initlock(&bsum.lock, "bsum");
+  bsum.nbmap = (sb.size + BPB - 1) / BPB;
+  if(bsum.nbmap * sizeof(int) > PGSIZE || (bsum.nfree = kzalloc()) == 0)
+    panic("bsuminit");
+  for(i = 0; i < bsum.nbmap; i++){
+    bp = bread(dev, sb.bmapstart + i);
+    for(bi = 0; bi < bmapbits(i); bi++)
+      if((bp->data[bi/8] & (1 << (bi % 8))) == 0)
+        bsum.nfree[i]++;
+    brelse(bp);
+  }
+}
 
-  bp = 0;
-  for(b = 0; b < sb.size; b += BPB){
-    bp = bread(dev, BBLOCK(b, sb));
-    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
-      m = 1 << (bi % 8);
-      if((bp->data[bi/8] & m) == 0){  // Is block free?
-        bp->data[bi/8] |= m;  // Mark block in use.
+// Is block b in a window?
+// Caller must hold bsum.lock.
+static int
+reserved(uint b)
+{
+  struct resv *r;
+
+  for(r = bsum.resv; r < &bsum.resv[NRESV]; r++)
+    if(r->ip && b >= r->start && b < r->start + r->len)
+      return 1;
+  return 0;
+}
+
+// Give back ip's window, or every window if ip is 0.
+// Caller must hold bsum.lock.
+static void
+resvdrop(struct inode *ip)
+{
+  struct resv *r;
+
+  for(r = bsum.resv; r < &bsum.resv[NRESV]; r++){
+    if(r->ip && (ip == 0 || r->ip == ip)){
+      bsum.nfree[r->start / BPB] += r->len;
+      r->ip = 0;
+    }
+  }
+}
+
+// Give back the blocks set aside for ip to grow into.
+void
+iunreserve(struct inode *ip)
+{
+  acquire(&bsum.lock);
+  resvdrop(ip);
+  release(&bsum.lock);
+}
+
+// Set aside the free blocks after the just-allocated block
+// b, which bitmap words w describe, for ip if ip is not 0,
+// and move the cursor past them. The caller holds b's
+// bitmap block, so no one else is scanning it.
+static void
+reserve(struct inode *ip, uint b, uint64 *w)
+{
+  struct resv *r, *free;
+  int i, bi, n;
+
+  acquire(&bsum.lock);
+  free = 0;
+  for(r = bsum.resv; ip && r < &bsum.resv[NRESV]; r++)
+    if(r->ip == 0 && free == 0)
+      free = r;
+  if(free){
+    // take no more than the unclaimed count, so that those
+    // who already claimed a block here still find one.
+    i = b / BPB;
+    for(n = 0; n < NPREALLOC && n < bsum.nfree[i]; n++){
+      bi = (b + 1 + n) % BPB;
+      if(bi == 0 || bi >= bmapbits(i) || (w[bi/64] & (1UL << (bi % 64))) ||
+         reserved(b + 1 + n))
+        break;
+    }
+    if(n > 0){
+      free->ip = ip;
+      free->start = b + 1;
+      free->len = n;
+      bsum.nfree[i] -= n;
+      b += n;
+    }
+  }
+  bsum.cursor = b + 1 < sb.size ? b + 1 : 0;
+  release(&bsum.lock);
+}
+
+// Allocate a zeroed disk block, the first free one at or
+// after goal if goal is not 0. If ip is not 0, the block is
+// for ip to grow into: it comes from ip's window if that
+// starts at goal, and otherwise gets a new window.
+static uint
+balloc(uint dev, uint goal, struct inode *ip)
+{
+  int i, n, start, first, bi, wi, nbits, nw;
+  uint64 *w;
+  struct buf *bp;
+  struct resv *r;
+  uint b, from;
+
+  if(ip && goal > 0 && goal < sb.size){
+    // the next block of ip's window, if it has one there:
+    // already claimed. Hold the bitmap block while taking
+    // it out of the window, so no scan can find it free.
+    bp = bread(dev, BBLOCK(goal, sb));
+    acquire(&bsum.lock);
+    for(r = bsum.resv; r < &bsum.resv[NRESV]; r++){
+      if(r->ip == ip && r->start == goal){
+        r->start++;
+        if(--r->len == 0)
+          r->ip = 0;
+        release(&bsum.lock);
+        bi = goal % BPB;
+        if(bp->data[bi/8] & (1 << (bi % 8)))
+          panic("balloc: reserved block in use");
+        bp->data[bi/8] |= 1 << (bi % 8);
         log_write(bp);
         brelse(bp);
-        bzero(dev, b + bi);
-        return b + bi;
+        bzero(dev, goal);
+        return goal;
       }
     }
+    release(&bsum.lock);
     brelse(bp);
   }
-  panic("balloc: out of blocks");
+
+  acquire(&bsum.lock);
+  if(ip)
+    resvdrop(ip);
+
+  // claim a free block in the first bitmap block at or
+  // after the goal (or cursor) that has one, taking the
+  // windows back if there is none.
+  from = goal > 0 && goal < sb.size ? goal : bsum.cursor;
+  start = from / BPB;
+  for(n = 0; n < 2*bsum.nbmap; n++){
+    if(n == bsum.nbmap)
+      resvdrop(0);
+    i = (start + n) % bsum.nbmap;
+    if(bsum.nfree[i] > 0)
+      break;
+  }
+  if(n == 2*bsum.nbmap)
+    panic("balloc: out of blocks");
+  bsum.nfree[i]--;
+  first = i == start ? from % BPB : 0;
+  release(&bsum.lock);
+
+  // find it, a word at a time, starting at the goal
+  // and wrapping around to the start of the block,
+  // skipping blocks in windows. The goal's word is
+  // scanned from the goal first, and from its start
+  // last, after the wrap.
+  nbits = bmapbits(i);
+  nw = (nbits + 63) / 64;
+  bp = bread(dev, sb.bmapstart + i);
+  w = (uint64*)bp->data;
+  for(n = 0; n <= nw; n++){
+    wi = (first/64 + n) % nw;
+    if(w[wi] == ~0UL)
+      continue;
+    for(bi = wi*64 + (n == 0 ? first % 64 : 0); bi < (wi+1)*64 && bi < nbits; bi++){
+      if((w[wi] & (1UL << (bi % 64))) == 0){  // Is block free?
+        b = i*BPB + bi;
+        acquire(&bsum.lock);
+        if(reserved(b)){
+          release(&bsum.lock);
+          continue;
+        }
+        release(&bsum.lock);
+        w[wi] |= 1UL << (bi % 64);  // Mark block in use.
+        reserve(ip, b, w);
+        log_write(bp);
+        brelse(bp);
+        bzero(dev, b);
+        return b;
+      }
+    }
+  }
+  panic("balloc: bitmap and summary disagree");
 }
 
 // Free a disk block.
@@ -100,6 +316,10 @@ bfree(int dev, uint b)
   bp->data[bi/8] &= ~m;
   log_write(bp);
   brelse(bp);
+
+  acquire(&bsum.lock);
+  bsum.nfree[b / BPB]++;
+  release(&bsum.lock);
 }
 
 // Inodes.
@@ -115,7 +335,9 @@ bfree(int dev, uint b)
 //
 // The kernel keeps a table of in-use inodes in memory
 // to provide a place for synchronizing access
-// to inodes used by multiple processes. The in-memory
+// to inodes used by multiple processes. The table is a
+// list of inodes allocated from a slab cache, so it grows
+// with the number of inodes in use. The in-memory
 // inodes include book-keeping information that is
 // not stored on disk: ip->ref and ip->valid.
 //
@@ -127,18 +349,17 @@ bfree(int dev, uint b)
 //   is non-zero. ialloc() allocates, and iput() frees if
 //   the reference and link counts have fallen to zero.
 //
-// * Referencing in table: an entry in the inode table
-//   is free if ip->ref is zero. Otherwise ip->ref tracks
-//   the number of in-memory pointers to the entry (open
-//   files and current directories). iget() finds or
-//   creates a table entry and increments its ref; iput()
-//   decrements ref.
+// * Referencing in table: ip->ref tracks the number of
+//   in-memory pointers to a table entry (open files and
+//   current directories). iget() finds or creates a table
+//   entry and increments its ref; iput() decrements ref,
+//   and frees the entry when ref reaches zero.
 //
 // * Valid: the information (type, size, &c) in an inode
 //   table entry is only correct when ip->valid is 1.
 //   ilock() reads the inode from
-//   the disk and sets ip->valid, while iput() clears
-//   ip->valid if ip->ref has fallen to zero.
+//   the disk and sets ip->valid; a new table entry
+//   starts out with ip->valid clear.
 //
 // * Locked: file system code may only examine and modify
 //   the information in an inode and its content if it
@@ -162,29 +383,31 @@ bfree(int dev, uint b)
 // have locked the inodes involved; this lets callers create
 // multi-step atomic operations.
 //
-// The itable.lock spin-lock protects the allocation of itable
-// entries. Since ip->ref indicates whether an entry is free,
-// and ip->dev and ip->inum indicate which i-node an entry
+// The itable.lock readers-writer spin-lock protects the list of
+// itable entries. Since ip->ref indicates whether an entry is in
+// use, and ip->dev and ip->inum indicate which i-node an entry
 // holds, one must hold itable.lock while using any of those fields.
+// Lookups that find their inode hold it shared, and so only
+// increment ip->ref, atomically; anything else that changes the
+// list or ip->ref holds it exclusively.
 //
-// An ip->lock sleep-lock protects all ip-> fields other than ref,
-// dev, and inum.  One must hold ip->lock in order to
+// An ip->lock readers-writer sleep-lock protects all ip-> fields
+// other than ref, dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
+// ilock() takes it exclusively; ilockshared() takes it shared, for
+// callers that only read, such as path name lookup.
 
 struct {
-  struct spinlock lock;
-  struct inode inode[NINODE];
+  struct rwspinlock lock;
+  struct kmem_cache cache;
+  struct inode *head;  // entries in use, through ip->next
 } itable;
 
 void
 iinit()
 {
-  int i = 0;
-  
-  initlock(&itable.lock, "itable");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&itable.inode[i].lock, "inode");
-  }
+  initrwlock(&itable.lock, "itable");
+  kmem_cache_init(&itable.cache, "inode", sizeof(struct inode));
 }
 
 static struct inode* iget(uint dev, uint inum);
@@ -231,7 +454,8 @@ iupdate(struct inode *ip)
   dip->minor = ip->minor;
   dip->nlink = ip->nlink;
   dip->size = ip->size;
-  memmove(dip->addrs, ip->addrs, sizeof(ip->addrs));
+  memmove(dip->ext, ip->ext, sizeof(ip->ext));
+  dip->dindirect = ip->dindirect;
   log_write(bp);
   brelse(bp);
 }
@@ -242,32 +466,44 @@ iupdate(struct inode *ip)
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
-
-  acquire(&itable.lock);
+  struct inode *ip;
 
   // Is the inode already in the table?
-  empty = 0;
-  for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-      ip->ref++;
-      release(&itable.lock);
+  acquireread(&itable.lock);
+  for(ip = itable.head; ip; ip = ip->next){
+    if(ip->dev == dev && ip->inum == inum){
+      __sync_fetch_and_add(&ip->ref, 1);
+      releaseread(&itable.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
   }
+  releaseread(&itable.lock);
 
-  // Recycle an inode entry.
-  if(empty == 0)
+  // Look again, since another process may have added it
+  // meanwhile, and if not, add a new entry.
+  acquirewrite(&itable.lock);
+  for(ip = itable.head; ip; ip = ip->next){
+    if(ip->dev == dev && ip->inum == inum){
+      ip->ref++;
+      releasewrite(&itable.lock);
+      return ip;
+    }
+  }
+  if((ip = kmem_cache_alloc(&itable.cache)) == 0)
     panic("iget: no inodes");
-
-  ip = empty;
+  initrwsleeplock(&ip->lock, "inode");
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
-  release(&itable.lock);
+  ip->ralast = 0;
+  ip->rahead = 0;
+  ip->prev = 0;
+  ip->next = itable.head;
+  if(itable.head)
+    itable.head->prev = ip;
+  itable.head = ip;
+  releasewrite(&itable.lock);
 
   return ip;
 }
@@ -277,9 +513,9 @@ iget(uint dev, uint inum)
 struct inode*
 idup(struct inode *ip)
 {
-  acquire(&itable.lock);
-  ip->ref++;
-  release(&itable.lock);
+  acquireread(&itable.lock);
+  __sync_fetch_and_add(&ip->ref, 1);
+  releaseread(&itable.lock);
   return ip;
 }
 
@@ -294,7 +530,7 @@ ilock(struct inode *ip)
   if(ip == 0 || ip->ref < 1)
     panic("ilock");
 
-  acquiresleep(&ip->lock);
+  acquirewritesleep(&ip->lock);
 
   if(ip->valid == 0){
     bp = bread(ip->dev, IBLOCK(ip->inum, sb));
@@ -304,7 +540,8 @@ ilock(struct inode *ip)
     ip->minor = dip->minor;
     ip->nlink = dip->nlink;
     ip->size = dip->size;
-    memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
+    memmove(ip->ext, dip->ext, sizeof(ip->ext));
+    ip->dindirect = dip->dindirect;
     brelse(bp);
     ip->valid = 1;
     if(ip->type == 0)
@@ -316,15 +553,45 @@ ilock(struct inode *ip)
 void
 iunlock(struct inode *ip)
 {
-  if(ip == 0 || !holdingsleep(&ip->lock) || ip->ref < 1)
+  if(ip == 0 || !holdingwritesleep(&ip->lock) || ip->ref < 1)
     panic("iunlock");
 
-  releasesleep(&ip->lock);
+  releasewritesleep(&ip->lock);
+}
+
+// Lock the given inode shared, for reading only: other
+// processes may hold it shared at the same time.
+// Reads the inode from disk if necessary.
+void
+ilockshared(struct inode *ip)
+{
+  if(ip == 0 || ip->ref < 1)
+    panic("ilockshared");
+
+  for(;;){
+    acquirereadsleep(&ip->lock);
+    if(ip->valid)
+      return;
+    // read it in under the exclusive lock, then try again.
+    releasereadsleep(&ip->lock);
+    ilock(ip);
+    iunlock(ip);
+  }
+}
+
+// Unlock an inode locked with ilockshared().
+void
+iunlockshared(struct inode *ip)
+{
+  if(ip == 0 || ip->ref < 1)
+    panic("iunlockshared");
+
+  releasereadsleep(&ip->lock);
 }
 
 // Drop a reference to an in-memory inode.
-// If that was the last reference, the inode table entry can
-// be recycled.
+// If that was the last reference, the inode table entry is
+// freed.
 // If that was the last reference and the inode has no links
 // to it, free the inode (and its content) on disk.
 // All calls to iput() must be inside a transaction in
@@ -332,29 +599,40 @@ iunlock(struct inode *ip)
 void
 iput(struct inode *ip)
 {
-  acquire(&itable.lock);
+  acquirewrite(&itable.lock);
 
   if(ip->ref == 1 && ip->valid && ip->nlink == 0){
     // inode has no links and no other references: truncate and free.
 
     // ip->ref == 1 means no other process can have ip locked,
-    // so this acquiresleep() won't block (or deadlock).
-    acquiresleep(&ip->lock);
+    // so this acquirewritesleep() won't block (or deadlock).
+    acquirewritesleep(&ip->lock);
 
-    release(&itable.lock);
+    releasewrite(&itable.lock);
 
     itrunc(ip);
     ip->type = 0;
     iupdate(ip);
     ip->valid = 0;
 
-    releasesleep(&ip->lock);
+    releasewritesleep(&ip->lock);
 
-    acquire(&itable.lock);
+    acquirewrite(&itable.lock);
   }
 
-  ip->ref--;
-  release(&itable.lock);
+  if(--ip->ref > 0){
+    releasewrite(&itable.lock);
+    return;
+  }
+  if(ip->prev)
+    ip->prev->next = ip->next;
+  else
+    itable.head = ip->next;
+  if(ip->next)
+    ip->next->prev = ip->prev;
+  releasewrite(&itable.lock);
+  iunreserve(ip);
+  kmem_cache_free(&itable.cache, ip);
 }
 
 // Common idiom: unlock, then put.
@@ -368,40 +646,88 @@ iunlockput(struct inode *ip)
 // Inode content
 //
 // The content (data) associated with each inode is stored
-// in blocks on the disk. The first NDIRECT block numbers
-// are listed in ip->addrs[].  The next NINDIRECT blocks are
-// listed in block ip->addrs[NDIRECT].
-
-// Return the disk block address of the nth block in inode ip.
-// If there is no such block, bmap allocates one.
+// in blocks on the disk. The file's first blocks are
+// described by up to NEXTENT extents in ip->ext[], each a
+// run of consecutive disk blocks, in file order; unused
+// extents have len 0. Files only grow at the end, so a new
+// block extends the last extent if the disk block after it
+// is free (as balloc()'s windows try to ensure), and
+// otherwise starts a new extent. Once all the extents are
+// in use, the blocks after them are listed through the
+// doubly-indirect block ip->dindirect, which holds the
+// addresses of up to NINDIRECT blocks of NINDIRECT block
+// addresses each. The extents then stay as they are until
+// the file is truncated.
+
+// Look up block bn, counted from the end of ip's extents,
+// in ip's doubly-indirect tree. If addr is not 0, the block
+// is new: enter addr for it, allocating the tree's blocks
+// as needed. Returns 0 if the block is not in the tree.
 static uint
-bmap(struct inode *ip, uint bn)
+dmap(struct inode *ip, uint bn, uint addr)
 {
-  uint addr, *a;
+  uint x, *a;
   struct buf *bp;
+  int i;
 
-  if(bn < NDIRECT){
-    if((addr = ip->addrs[bn]) == 0)
-      ip->addrs[bn] = addr = balloc(ip->dev);
-    return addr;
-  }
-  bn -= NDIRECT;
+  if(bn >= NINDIRECT*NINDIRECT)
+    panic("bmap: out of range");
 
-  if(bn < NINDIRECT){
-    // Load indirect block, allocating if necessary.
-    if((addr = ip->addrs[NDIRECT]) == 0)
-      ip->addrs[NDIRECT] = addr = balloc(ip->dev);
-    bp = bread(ip->dev, addr);
-    a = (uint*)bp->data;
-    if((addr = a[bn]) == 0){
-      a[bn] = addr = balloc(ip->dev);
+  if((x = ip->dindirect) == 0){
+    if(addr == 0)
+      return 0;
+    ip->dindirect = x = balloc(ip->dev, 0, 0);
+  }
+  for(i = 0; i < 2 && x; i++){
+    bp = bread(ip->dev, x);
+    a = (uint*)bp->data + (i == 0 ? bn / NINDIRECT : bn % NINDIRECT);
+    if((x = *a) == 0 && addr){
+      *a = x = i == 1 ? addr : balloc(ip->dev, 0, 0);
       log_write(bp);
     }
     brelse(bp);
-    return addr;
   }
+  return x;
+}
+
+// Return the disk block address of the nth block in inode ip.
+// If there is no such block, bmap allocates one.
+static uint
+bmap(struct inode *ip, uint bn)
+{
+  struct extent *e;
+  uint addr, goal;
+  int i;
+
+  for(i = 0; i < NEXTENT && ip->ext[i].len > 0; i++){
+    e = &ip->ext[i];
+    if(bn < e->len)
+      return e->start + bn;
+    bn -= e->len;
+  }
+  if(ip->dindirect && (addr = dmap(ip, bn, 0)) != 0)
+    return addr;
 
-  panic("bmap: out of range");
+  // the block just past the end of the file: allocate it
+  // right after the file's last block if possible, from
+  // the file's window if it is a regular file.
+  e = i > 0 ? &ip->ext[i-1] : 0;
+  if(bn == 0)
+    goal = e ? e->start + e->len : 0;
+  else if((goal = dmap(ip, bn - 1, 0)) != 0)
+    goal++;
+  else
+    panic("bmap: hole");
+  addr = balloc(ip->dev, goal, ip->type == T_FILE ? ip : 0);
+  if(ip->dindirect == 0 && e && addr == goal){
+    e->len++;
+  } else if(ip->dindirect == 0 && i < NEXTENT){
+    ip->ext[i].start = addr;
+    ip->ext[i].len = 1;
+  } else {
+    dmap(ip, bn, addr);
+  }
+  return addr;
 }
 
 // Truncate inode (discard contents).
@@ -410,26 +736,35 @@ void
 itrunc(struct inode *ip)
 {
   int i, j;
-  struct buf *bp;
-  uint *a;
-
-  for(i = 0; i < NDIRECT; i++){
-    if(ip->addrs[i]){
-      bfree(ip->dev, ip->addrs[i]);
-      ip->addrs[i] = 0;
-    }
+  uint b;
+  struct buf *bp, *bp1;
+  uint *a, *a1;
+
+  for(i = 0; i < NEXTENT; i++){
+    for(b = 0; b < ip->ext[i].len; b++)
+      bfree(ip->dev, ip->ext[i].start + b);
+    ip->ext[i].start = 0;
+    ip->ext[i].len = 0;
   }
 
-  if(ip->addrs[NDIRECT]){
-    bp = bread(ip->dev, ip->addrs[NDIRECT]);
+  if(ip->dindirect){
+    bp = bread(ip->dev, ip->dindirect);
     a = (uint*)bp->data;
-    for(j = 0; j < NINDIRECT; j++){
-      if(a[j])
-        bfree(ip->dev, a[j]);
+    for(i = 0; i < NINDIRECT; i++){
+      if(a[i] == 0)
+        continue;
+      bp1 = bread(ip->dev, a[i]);
+      a1 = (uint*)bp1->data;
+      for(j = 0; j < NINDIRECT; j++){
+        if(a1[j])
+          bfree(ip->dev, a1[j]);
+      }
+      brelse(bp1);
+      bfree(ip->dev, a[i]);
     }
     brelse(bp);
-    bfree(ip->dev, ip->addrs[NDIRECT]);
-    ip->addrs[NDIRECT] = 0;
+    bfree(ip->dev, ip->dindirect);
+    ip->dindirect = 0;
   }
 
   ip->size = 0;
@@ -448,6 +783,42 @@ stati(struct inode *ip, struct stat *st)
   st->size = ip->size;
 }
 
+// If reads of ip have been sequential, start reading the
+// blocks from first up to NREADAHEAD blocks past last,
+// without waiting, so that they are in the cache (or on
+// their way) by the time readi() needs them.
+// The read-ahead state is only a hint, so it is fine for
+// processes holding ip->lock shared to race on it.
+static void
+readahead(struct inode *ip, uint first, uint last)
+{
+  uint bn, end, nblock, addrs[NREADAHEAD];
+  int n;
+
+  if(first != 0 && first != ip->ralast && first != ip->ralast + 1){
+    // not sequential: stop reading ahead until it is again.
+    ip->ralast = last;
+    ip->rahead = 0;
+    return;
+  }
+  ip->ralast = last;
+
+  nblock = (ip->size + BSIZE - 1) / BSIZE;
+  end = last + 1 + NREADAHEAD;
+  if(end > nblock)
+    end = nblock;
+  bn = ip->rahead > first + 1 ? ip->rahead : first + 1;
+  while(bn < end){
+    // a batch at a time, so that blocks that are consecutive
+    // on disk are read with one request.
+    for(n = 0; n < NREADAHEAD && bn < end; n++, bn++)
+      addrs[n] = bmap(ip, bn);
+    breadahead(ip->dev, addrs, n);
+  }
+  if(bn > ip->rahead)
+    ip->rahead = bn;
+}
+
 // Read data from inode.
 // Caller must hold ip->lock.
 // If user_dst==1, then dst is a user virtual address;
@@ -462,6 +833,8 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
     return 0;
   if(off + n > ip->size)
     n = ip->size - off;
+  if(n > 0)
+    readahead(ip, off/BSIZE, (off + n - 1)/BSIZE);
 
   for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
     bp = bread(ip->dev, bmap(ip, off/BSIZE));
@@ -510,7 +883,7 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
 
   // write the i-node back to disk even if the size didn't change
   // because the loop above might have called bmap() and added a new
-  // block to ip->addrs[].
+  // block to ip->ext[].
   iupdate(ip);
 
   return tot;
@@ -526,6 +899,7 @@ namecmp(const char *s, const char *t)
 
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
+// Caller must hold dp->lock, shared or exclusive.
 struct inode*
 dirlookup(struct inode *dp, char *name, uint *poff)
 {
@@ -635,22 +1009,27 @@ namex(char *path, int nameiparent, char *name)
   else
     ip = idup(myproc()->cwd);
 
+  // lookups only read directories, so any number of
+  // processes can search the same directory at once.
   while((path = skipelem(path, name)) != 0){
-    ilock(ip);
+    ilockshared(ip);
     if(ip->type != T_DIR){
-      iunlockput(ip);
+      iunlockshared(ip);
+      iput(ip);
       return 0;
     }
     if(nameiparent && *path == '\0'){
       // Stop one level early.
-      iunlock(ip);
+      iunlockshared(ip);
       return ip;
     }
     if((next = dirlookup(ip, name, 0)) == 0){
-      iunlockput(ip);
+      iunlockshared(ip);
+      iput(ip);
       return 0;
     }
-    iunlockput(ip);
+    iunlockshared(ip);
+    iput(ip);
     ip = next;
   }
   if(nameiparent){
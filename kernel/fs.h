@@ -20,13 +20,20 @@ struct superblock {
   uint logstart;     // Block number of first log block
   uint inodestart;   // Block number of first inode block
   uint bmapstart;    // Block number of first free map block
+  uint maxop;        // Most log blocks one FS operation may write
 };
 
-#define FSMAGIC 0x10203040
+#define FSMAGIC 0x10203041
 
-#define NDIRECT 12
+#define NEXTENT 6
 #define NINDIRECT (BSIZE / sizeof(uint))
-#define MAXFILE (NDIRECT + NINDIRECT)
+#define MAXFILE (NINDIRECT * NINDIRECT)
+
+// A run of len consecutive disk blocks starting at start.
+struct extent {
+  uint start;
+  uint len;
+};
 
 // On-disk inode structure
 struct dinode {
@@ -35,7 +42,8 @@ struct dinode {
   short minor;          // Minor device number (T_DEVICE only)
   short nlink;          // Number of links to inode in file system
   uint size;            // Size of file (bytes)
-  uint addrs[NDIRECT+1];   // Data block addresses
+  struct extent ext[NEXTENT]; // Runs holding the first blocks, in order
+  uint dindirect;       // Doubly-indirect block for the blocks after them
 };
 
 // Inodes per block.
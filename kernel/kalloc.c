@@ -1,12 +1,21 @@
 // Physical memory allocator, for user processes,
 // kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// and pipe buffers. Allocates blocks of 2^order
+// physically contiguous 4096-byte pages.
+//
+// A binary buddy allocator: there is one free list per
+// order, and a free block of order k starting at page i
+// has its buddy at page i ^ (1 << k). Freeing a block
+// coalesces it with its buddy for as long as the buddy
+// is free too, so memory released by exiting processes
+// comes back as large contiguous blocks.
 
 #include "types.h"
 #include "param.h"
 #include "memlayout.h"
 #include "spinlock.h"
 #include "riscv.h"
+#include "proc.h"
 #include "defs.h"
 
 void freerange(void *pa_start, void *pa_end);
@@ -14,19 +23,125 @@ void freerange(void *pa_start, void *pa_end);
 extern char end[]; // first address after kernel.
                    // defined by kernel.ld.
 
+// Free blocks live on circular doubly-linked lists,
+// threaded through their first page, so that a buddy
+// can be unlinked from the middle of its list.
 struct run {
   struct run *next;
+  struct run *prev;
 };
 
+#define NPAGES ((PHYSTOP - KERNBASE) / PGSIZE)
+#define PA2PG(pa) (((uint64)(pa) - KERNBASE) / PGSIZE)
+#define PG2PA(i) ((uint64)(i) * PGSIZE + KERNBASE)
+
+// pgorder[i] describes the block starting at page i:
+// FREE|k if it heads a free block of order k, k if it
+// heads an allocated block of order k, 0 otherwise.
+#define FREE 0x80
+
+// Idle CPUs zero free pages ahead of time (see kzeroidle())
+// so that kzalloc() can usually hand out a page without
+// touching it. At most NZERO pages are kept pre-zeroed.
+#define NZERO 256
+
 struct {
   struct spinlock lock;
-  struct run *freelist;
+  struct run free[MAXORDER+1]; // list heads, one per order
+  int nfree[MAXORDER+1];       // blocks on each list
+  uchar pgorder[NPAGES];
+  struct run *zerolist;  // pages that are zero apart from r->next
+  int nzero;
 } kmem;
 
+static void
+list_init(struct run *h)
+{
+  h->next = h;
+  h->prev = h;
+}
+
+static void
+list_push(struct run *h, struct run *r)
+{
+  r->next = h->next;
+  r->prev = h;
+  h->next->prev = r;
+  h->next = r;
+}
+
+static void
+list_remove(struct run *r)
+{
+  r->prev->next = r->next;
+  r->next->prev = r->prev;
+}
+
+// Take a block of 2^order pages off the free lists,
+// splitting a larger block if necessary.
+// Caller must hold kmem.lock.
+static void *
+buddy_alloc(int order)
+{
+  struct run *r;
+  uint64 i;
+  int k;
+
+  for(k = order; k <= MAXORDER; k++)
+    if(kmem.free[k].next != &kmem.free[k])
+      break;
+  if(k > MAXORDER)
+    return 0;
+
+  r = kmem.free[k].next;
+  list_remove(r);
+  kmem.nfree[k]--;
+  i = PA2PG(r);
+
+  // Give back the upper half until the block is small enough.
+  while(k > order){
+    k--;
+    uint64 b = i + (1L << k);
+    kmem.pgorder[b] = FREE | k;
+    list_push(&kmem.free[k], (struct run*)PG2PA(b));
+    kmem.nfree[k]++;
+  }
+  kmem.pgorder[i] = order;
+  return (void*)r;
+}
+
+// Return a block of 2^order pages to the free lists,
+// merging it with its buddy as long as the buddy is free.
+// Caller must hold kmem.lock.
+static void
+buddy_free(void *pa, int order)
+{
+  uint64 i, b;
+
+  i = PA2PG(pa);
+  while(order < MAXORDER){
+    b = i ^ (1L << order);
+    if(b >= NPAGES || kmem.pgorder[b] != (FREE | order))
+      break;
+    list_remove((struct run*)PG2PA(b));
+    kmem.nfree[order]--;
+    kmem.pgorder[b] = 0;
+    kmem.pgorder[i] = 0;
+    if(b < i)
+      i = b;
+    order++;
+  }
+  kmem.pgorder[i] = FREE | order;
+  list_push(&kmem.free[order], (struct run*)PG2PA(i));
+  kmem.nfree[order]++;
+}
+
 void
 kinit()
 {
   initlock(&kmem.lock, "kmem");
+  for(int k = 0; k <= MAXORDER; k++)
+    list_init(&kmem.free[k]);
   freerange(end, (void*)PHYSTOP);
 }
 
@@ -39,27 +154,77 @@ freerange(void *pa_start, void *pa_end)
     kfree(p);
 }
 
-// Free the page of physical memory pointed at by v,
-// which normally should have been returned by a
-// call to kalloc().  (The exception is when
-// initializing the allocator; see kinit above.)
+// Free the block of 2^order pages of physical memory
+// pointed at by pa, which normally should have been
+// returned by a call to kalloc_pages(order).  (The
+// exception is when initializing the allocator; see
+// kinit above.)
 void
-kfree(void *pa)
+kfree_pages(void *pa, int order)
 {
-  struct run *r;
-
-  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+  if(order < 0 || order > MAXORDER ||
+     ((uint64)pa % (PGSIZE << order)) != 0 ||
+     (char*)pa < end || (uint64)pa + (PGSIZE << order) > PHYSTOP)
     panic("kfree");
 
+#ifndef PERF
   // Fill with junk to catch dangling refs.
-  memset(pa, 1, PGSIZE);
+  memset(pa, 1, PGSIZE << order);
+#endif
 
-  r = (struct run*)pa;
+  acquire(&kmem.lock);
+  if(kmem.pgorder[PA2PG(pa)] & FREE)
+    panic("kfree: double free");
+  buddy_free(pa, order);
+  release(&kmem.lock);
+}
+
+// Free the page of physical memory pointed at by pa.
+void
+kfree(void *pa)
+{
+  kfree_pages(pa, 0);
+}
+
+// Allocate 2^order physically contiguous pages, aligned
+// to their size.
+// Returns a pointer that the kernel can use.
+// Returns 0 if the memory cannot be allocated.
+void *
+kalloc_pages(int order)
+{
+  struct run *r;
+
+  if(order < 0 || order > MAXORDER)
+    return 0;
 
   acquire(&kmem.lock);
-  r->next = kmem.freelist;
-  kmem.freelist = r;
+  r = buddy_alloc(order);
+  if(r == 0 && order == 0 && (r = kmem.zerolist) != 0){
+    kmem.zerolist = r->next;
+    kmem.nzero--;
+  }
   release(&kmem.lock);
+
+  // out of memory: take pages back from the buffer cache,
+  // or from objects idling in slab magazines. Reaping takes
+  // every cache's locks, so only a caller that holds no
+  // spinlock (not the slab allocator itself) may reap.
+  if(r == 0 && bshrink(1 << order) > 0)
+    return kalloc_pages(order);
+  if(r == 0){
+    push_off();
+    int locked = mycpu()->noff > 1;
+    pop_off();
+    if(!locked && kmem_cache_reap() > 0)
+      return kalloc_pages(order);
+  }
+
+#ifndef PERF
+  if(r)
+    memset((char*)r, 5, PGSIZE << order); // fill with junk
+#endif
+  return (void*)r;
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -67,16 +232,72 @@ kfree(void *pa)
 // Returns 0 if the memory cannot be allocated.
 void *
 kalloc(void)
+{
+  return kalloc_pages(0);
+}
+
+// Allocate one zeroed 4096-byte page of physical memory.
+// Uses a page zeroed in the background by kzeroidle() if
+// there is one, otherwise zeroes a page from kalloc().
+// Returns 0 if the memory cannot be allocated.
+void *
+kzalloc(void)
 {
   struct run *r;
 
   acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
+  r = kmem.zerolist;
+  if(r){
+    kmem.zerolist = r->next;
+    kmem.nzero--;
+  }
   release(&kmem.lock);
 
-  if(r)
-    memset((char*)r, 5, PGSIZE); // fill with junk
+  if(r){
+    r->next = 0;
+    return (void*)r;
+  }
+  if((r = kalloc()) != 0)
+    memset((char*)r, 0, PGSIZE);
   return (void*)r;
 }
+
+// Move one free page to the pre-zeroed pool.
+// Called by scheduler() when it has nothing to run.
+// Returns 1 if a page was zeroed, 0 if there was nothing to do.
+int
+kzeroidle(void)
+{
+  struct run *r;
+
+  acquire(&kmem.lock);
+  if(kmem.nzero >= NZERO || (r = buddy_alloc(0)) == 0){
+    release(&kmem.lock);
+    return 0;
+  }
+  release(&kmem.lock);
+
+  memset((char*)r, 0, PGSIZE);
+
+  acquire(&kmem.lock);
+  r->next = kmem.zerolist;
+  kmem.zerolist = r;
+  kmem.nzero++;
+  release(&kmem.lock);
+  return 1;
+}
+
+// Report the number of free blocks of each order in
+// nfree[0..n-1]; pre-zeroed pages count as order 0.
+// Returns the number of orders the allocator has.
+int
+kmeminfo(int *nfree, int n)
+{
+  acquire(&kmem.lock);
+  for(int k = 0; k < n && k <= MAXORDER; k++)
+    nfree[k] = kmem.nfree[k];
+  if(n > 0)
+    nfree[0] += kmem.nzero;
+  release(&kmem.lock);
+  return MAXORDER+1;
+}
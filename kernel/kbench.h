@@ -0,0 +1,8 @@
+// Kernel self-benchmarks selectable through kbench().
+#define KBENCH_MEMMOVE  1  // memmove throughput across the direct map
+#define KBENCH_MEMSET   2  // memset of whole pages
+#define KBENCH_MEMCMP   3  // memcmp of equal pages
+
+// lockbench() waits, in histogram buckets: bucket i counts
+// acquires that took 2^i to 2^(i+1)-1 cycles.
+#define LOCKBENCH_NHIST 32
@@ -0,0 +1,8 @@
+// Contention statistics for all spinlocks of one name,
+// as reported by lockstat().
+struct lockstat {
+  char name[16];
+  uint64 nacquire;   // acquire() calls
+  uint64 ncontend;   // acquire() calls that found the lock held
+  uint64 spin;       // cycles spent waiting for the lock
+};
@@ -4,6 +4,7 @@
 #include "param.h"
 #include "spinlock.h"
 #include "sleeplock.h"
+#include "proc.h"
 #include "fs.h"
 #include "buf.h"
 
@@ -16,38 +17,68 @@
 // write an uncommitted system call's updates to disk.
 //
 // A system call should call begin_op()/end_op() to mark
-// its start and end. Usually begin_op() just increments
-// the count of in-progress FS system calls and returns.
-// But if it thinks the log is close to running out, it
-// sleeps until the last outstanding end_op() commits.
+// its start and end. begin_op() reserves MAXOPBLOCKS log
+// blocks, enough for any FS system call but a file write;
+// a write reserves what it needs with begin_opn(), up to
+// the limit mkfs recorded in the superblock. Usually
+// begin_op() just adds the reservation to the total and
+// returns. But if the log might run out, it sleeps until
+// the last outstanding end_op() commits.
 //
 // The log is a physical re-do log containing disk blocks.
-// The on-disk log format:
-//   header block, containing block #s for block A, B, C, ...
+// It is double-buffered: it has two halves, and successive
+// transactions alternate between them. Each half has the
+// on-disk format:
+//   header block, containing a sequence number and
+//     block #s for block A, B, C, ...
 //   block A
 //   block B
 //   block C
 //   ...
-// Log appends are synchronous.
+// Once a transaction's header is on disk it has committed,
+// and new FS system calls may start while the committing
+// process installs it, using the other half of the log for
+// the next transaction. Installs happen one at a time, in
+// commit order. Recovery installs whatever committed
+// transactions the two halves hold, in sequence order.
+//
+// Log appends are synchronous, but the blocks of a commit
+// are written to the disk in parallel, with consecutive
+// blocks combined into single requests.
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
 struct logheader {
   int n;
+  uint seq;
   int block[LOGSIZE];
 };
 
 struct log {
   struct spinlock lock;
   int start;
-  int size;
+  int size;        // blocks in each half, header included
+  int maxop;       // most blocks one FS sys call may reserve
   int outstanding; // how many FS sys calls are executing.
-  int committing;  // in commit(), please wait.
+  int reserved;    // blocks they have reserved
+  int committing;  // in commit() writing the log, please wait.
+  int cur;         // half the current transaction will use
+  int busy[2];     // half holds a transaction not yet installed
+  uint seq;        // sequence number of the next commit
+  uint installseq; // sequence number of the next install
   int dev;
   struct logheader lh;
+  struct logheader committed[2]; // each half's transaction, once committed
+  struct buf *wbuf[LOGSIZE];     // write_log()'s log blocks
 };
 struct log log;
 
+// Installs write each block home from one of these rather
+// than from the block's cached buffer, which the next
+// transaction may already be changing, NSHADOW at a time.
+#define NSHADOW 32
+static struct buf shadow[NSHADOW];
+
 static void recover_from_log(void);
 static void commit();
 
@@ -58,56 +89,81 @@ initlog(int dev, struct superblock *sb)
     panic("initlog: too big logheader");
 
   initlock(&log.lock, "log");
+  for(int i = 0; i < NSHADOW; i++)
+    initsleeplock(&shadow[i].lock, "shadow");
   log.start = sb->logstart;
-  log.size = sb->nlog;
+  log.size = sb->nlog / 2;
+  log.maxop = sb->maxop ? sb->maxop : MAXOPBLOCKS;
+  if(log.size - 1 > LOGSIZE)
+    panic("initlog: log too big");
+  if(log.maxop < MAXOPBLOCKS || log.maxop > log.size - 1)
+    panic("initlog: bad maxop");
   log.dev = dev;
   recover_from_log();
 }
 
-// Copy committed blocks from log to their home location
+// Copy committed blocks from log half to their home
+// location. Starts all the writes before waiting for any,
+// so that the disk has them all in flight at once, and
+// writes runs of consecutive home blocks with single requests.
 static void
-install_trans(int recovering)
+install_trans(int half, struct logheader *lh, int recovering)
 {
-  int tail;
+  struct buf *sbuf[NSHADOW];
+  int tail, i, n;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);  // write dst to disk
-    if(recovering == 0)
-      bunpin(dbuf);
-    brelse(lbuf);
-    brelse(dbuf);
+  for (tail = 0; tail < lh->n; tail += n) {
+    n = lh->n - tail < NSHADOW ? lh->n - tail : NSHADOW;
+    for (i = 0; i < n; i++) {
+      struct buf *lbuf = bread(log.dev, log.start+half*log.size+tail+i+1); // read log block
+      sbuf[i] = &shadow[i];
+      acquiresleep(&sbuf[i]->lock);
+      sbuf[i]->dev = log.dev;
+      sbuf[i]->blockno = lh->block[tail+i];
+      memmove(sbuf[i]->data, lbuf->data, BSIZE);  // copy block to dst
+      brelse(lbuf);
+    }
+    bawrite(sbuf, n);  // write dst to disk
+    for (i = 0; i < n; i++) {
+      bwait(sbuf[i]);
+      if(recovering == 0){
+        struct buf *dbuf = bread(log.dev, sbuf[i]->blockno);
+        bunpin(dbuf);
+        brelse(dbuf);
+      }
+      releasesleep(&sbuf[i]->lock);
+    }
   }
 }
 
-// Read the log header from disk into the in-memory log header
+// Read the header of log half into lh.
 static void
-read_head(void)
+read_head(int half, struct logheader *lh)
 {
-  struct buf *buf = bread(log.dev, log.start);
-  struct logheader *lh = (struct logheader *) (buf->data);
+  struct buf *buf = bread(log.dev, log.start+half*log.size);
+  struct logheader *hb = (struct logheader *) (buf->data);
   int i;
-  log.lh.n = lh->n;
-  for (i = 0; i < log.lh.n; i++) {
-    log.lh.block[i] = lh->block[i];
+  lh->n = hb->n;
+  lh->seq = hb->seq;
+  for (i = 0; i < lh->n; i++) {
+    lh->block[i] = hb->block[i];
   }
   brelse(buf);
 }
 
-// Write in-memory log header to disk.
-// This is the true point at which the
-// current transaction commits.
+// Write lh to the header of log half.
+// This is the true point at which a
+// transaction commits.
 static void
-write_head(void)
+write_head(int half, struct logheader *lh)
 {
-  struct buf *buf = bread(log.dev, log.start);
+  struct buf *buf = bread(log.dev, log.start+half*log.size);
   struct logheader *hb = (struct logheader *) (buf->data);
   int i;
-  hb->n = log.lh.n;
-  for (i = 0; i < log.lh.n; i++) {
-    hb->block[i] = log.lh.block[i];
+  hb->n = lh->n;
+  hb->seq = lh->seq;
+  for (i = 0; i < lh->n; i++) {
+    hb->block[i] = lh->block[i];
   }
   bwrite(buf);
   brelse(buf);
@@ -116,31 +172,77 @@ write_head(void)
 static void
 recover_from_log(void)
 {
-  read_head();
-  install_trans(1); // if committed, copy from log to disk
-  log.lh.n = 0;
-  write_head(); // clear the log
+  struct logheader *lh = log.committed;
+  int first, i, h;
+
+  read_head(0, &lh[0]);
+  read_head(1, &lh[1]);
+  // if both halves hold committed transactions,
+  // the one with the lower sequence number came first.
+  first = (lh[0].n > 0 && lh[1].n > 0 && lh[1].seq < lh[0].seq);
+  for(i = 0; i < 2; i++){
+    h = first ^ i;
+    install_trans(h, &lh[h], 1); // if committed, copy from log to disk
+  }
+  log.seq = (lh[0].seq > lh[1].seq ? lh[0].seq : lh[1].seq) + 1;
+  log.installseq = log.seq;
+  for(h = 0; h < 2; h++){
+    lh[h].n = 0;
+    write_head(h, &lh[h]); // clear the log
+  }
 }
 
-// called at the start of each FS system call.
+// called at the start of each FS system call that may
+// write up to n blocks.
 void
-begin_op(void)
+begin_opn(int n)
 {
+  if(n > log.maxop)
+    panic("begin_opn");
+
   acquire(&log.lock);
   while(1){
     if(log.committing){
       sleep(&log, &log.lock);
-    } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){
+    } else if(log.lh.n + log.reserved + n > log.size - 1){
       // this op might exhaust log space; wait for commit.
       sleep(&log, &log.lock);
     } else {
       log.outstanding += 1;
+      log.reserved += n;
+      myproc()->logres = n;
       release(&log.lock);
       break;
     }
   }
 }
 
+// called at the start of each FS system call.
+void
+begin_op(void)
+{
+  begin_opn(MAXOPBLOCKS);
+}
+
+// Most bytes one FS system call may write to a file.
+int
+log_maxwrite(void)
+{
+  // leave room for the i-node, the doubly-indirect block
+  // and two indirect blocks, and 2 blocks of slop for
+  // non-aligned writes; each block but the i-node may also
+  // need an allocation bitmap block.
+  return ((log.maxop-1-2*3-2) / 2) * BSIZE;
+}
+
+// Log blocks to reserve for writing n bytes to a file,
+// n being at most log_maxwrite().
+int
+log_writeblocks(int n)
+{
+  return 1+2*3+2 + 2*((n + BSIZE - 1) / BSIZE);
+}
+
 // called at the end of each FS system call.
 // commits if this was the last outstanding operation.
 void
@@ -150,6 +252,8 @@ end_op(void)
 
   acquire(&log.lock);
   log.outstanding -= 1;
+  log.reserved -= myproc()->logres;
+  myproc()->logres = 0;
   if(log.committing)
     panic("log.committing");
   if(log.outstanding == 0){
@@ -167,39 +271,79 @@ end_op(void)
     // call commit w/o holding locks, since not allowed
     // to sleep with locks.
     commit();
-    acquire(&log.lock);
-    log.committing = 0;
-    wakeup(&log);
-    release(&log.lock);
   }
 }
 
-// Copy modified blocks from cache to log.
+// Copy modified blocks from cache to log half. The log
+// blocks are consecutive, so they go to the disk as one request.
 static void
-write_log(void)
+write_log(int half, struct logheader *lh)
 {
+  struct buf **to = log.wbuf;
   int tail;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
-    struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
+  for (tail = 0; tail < lh->n; tail++) {
+    to[tail] = bread(log.dev, log.start+half*log.size+tail+1); // log block
+    struct buf *from = bread(log.dev, lh->block[tail]); // cache block
+    memmove(to[tail]->data, from->data, BSIZE);
     brelse(from);
-    brelse(to);
+  }
+  bawrite(to, lh->n);  // write the log
+  for (tail = 0; tail < lh->n; tail++) {
+    bwait(to[tail]);
+    brelse(to[tail]);
   }
 }
 
+// Commit the current transaction, then let the next one
+// start while this one installs. Called with log.committing
+// set, by the process whose end_op() ended the transaction.
 static void
 commit()
 {
-  if (log.lh.n > 0) {
-    write_log();     // Write modified blocks from cache to log
-    write_head();    // Write header to disk -- the real commit
-    install_trans(0); // Now install writes to home locations
-    log.lh.n = 0;
-    write_head();    // Erase the transaction from the log
+  struct logheader *lh;
+  int half;
+
+  acquire(&log.lock);
+  if(log.lh.n == 0){
+    log.committing = 0;
+    wakeup(&log);
+    release(&log.lock);
+    return;
   }
+  // wait for the transaction before last, which used
+  // this half, to be installed.
+  half = log.cur;
+  while(log.busy[half])
+    sleep(&log, &log.lock);
+  log.busy[half] = 1;
+  lh = &log.committed[half];
+  *lh = log.lh;
+  lh->seq = log.seq++;
+  release(&log.lock);
+
+  write_log(half, lh);     // Write modified blocks from cache to log
+  write_head(half, lh);    // Write header to disk -- the real commit
+
+  // new FS system calls can start now.
+  acquire(&log.lock);
+  log.lh.n = 0;
+  log.cur = half ^ 1;
+  log.committing = 0;
+  wakeup(&log);
+  while(log.installseq != lh->seq)
+    sleep(&log, &log.lock);
+  release(&log.lock);
+
+  install_trans(half, lh, 0); // Now install writes to home locations
+  lh->n = 0;
+  write_head(half, lh);    // Erase the transaction from the log
+
+  acquire(&log.lock);
+  log.installseq++;
+  log.busy[half] = 0;
+  wakeup(&log);
+  release(&log.lock);
 }
 
 // Caller has modified b->data and is done with the buffer.
@@ -29,9 +29,15 @@
 #define CLINT 0x2000000L
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8*(hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8) // cycles since boot.
+#define TIMEFREQ 10000000L // mtime and the time CSR tick at 10 MHz.
+#define TICKINTERVAL 1000000L // mtime ticks between clock ticks; 1/10th second.
 
 // qemu puts platform-level interrupt controller (PLIC) here.
 #define PLIC 0x0c000000L
+
+// with UACCESSFLG=ON, the kernel reaches user addresses below
+// UMIRROR directly; see uvmmirror() in vm.c.
+#define UMIRROR PLIC
 #define PLIC_PRIORITY (PLIC + 0x0)
 #define PLIC_PENDING (PLIC + 0x1000)
 #define PLIC_MENABLE(hart) (PLIC + 0x2000 + (hart)*0x100)
@@ -62,6 +68,31 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   mmap regions, growing down from MMAPTOP
+//   ...
+//   URING (p->uring, if the process called uring_setup())
+//   USHARED (ushared, read-only)
+//   USYSCALL (p->usyscall, read-only)
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+#define USYSCALL (TRAPFRAME - PGSIZE)
+#define USHARED (USYSCALL - PGSIZE)
+#define URING (USHARED - PGSIZE)
+#define MMAPTOP (MAXVA / 2)
+
+// The USYSCALL and USHARED pages are read-only to user code,
+// so user/ulib.c can answer getpid(), uptime(), get_cpu() and
+// cpu_process_count() without a system call.
+
+// per-process page at USYSCALL.
+struct usyscall {
+  int pid;           // Process ID
+  int cpu;           // CPU the process last started running on
+};
+
+// one page, shared by all processes, at USHARED.
+struct ushared {
+  uint ticks;        // copy of ticks
+  int runq[NCPU];    // copy of each cpus[i].counter
+};
@@ -0,0 +1,322 @@
+//
+// Memory-mapped files.
+//
+// mmap() only records a region in the process's vma[] table;
+// pages are read from the file when the process first touches
+// them (mmapfault(), called from usertrap() and from copyin()
+// and copyout()). Regions are placed top-down from MMAPTOP.
+//
+// A MAP_SHARED region writes modified pages back to the file
+// when it is unmapped (by munmap(), exit() or exec()). Pages
+// of a writable MAP_SHARED region are first mapped read-only;
+// the first store to a page makes it writable and sets PTE_D,
+// so only pages that were actually written go back to disk.
+// A MAP_PRIVATE region is never written back.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "fcntl.h"
+
+static struct vma*
+findvma(struct proc *p, uint64 va)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->f && va >= v->addr && va < v->addr + v->len)
+      return v;
+  return 0;
+}
+
+// The lowest address of p's regions, or MMAPTOP if it has
+// none: the heap must stay below it.
+uint64
+mmapbase(struct proc *p)
+{
+  struct vma *v;
+  uint64 base = MMAPTOP;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->f && v->addr < base)
+      base = v->addr;
+  return base;
+}
+
+// Map len bytes of file f, starting at page-aligned offset off.
+// The region goes below the others, and must stay above the
+// heap. Returns the address of the region, or -1.
+uint64
+mmap(uint64 len, int prot, int flags, struct file *f, uint off)
+{
+  struct proc *p = myproc();
+  struct vma *v, *free;
+  uint64 top;
+
+  if(len == 0 || off % PGSIZE != 0 || f->type != FD_INODE)
+    return -1;
+  if(flags != MAP_SHARED && flags != MAP_PRIVATE)
+    return -1;
+  if((prot & PROT_READ) && !f->readable)
+    return -1;
+  if(flags == MAP_SHARED && (prot & PROT_WRITE) && !f->writable)
+    return -1;
+
+  len = PGROUNDUP(len);
+  free = 0;
+  top = MMAPTOP;
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->f == 0){
+      if(free == 0)
+        free = v;
+    } else if(v->addr < top)
+      top = v->addr;
+  }
+  if(free == 0 || len > top || top - len < PGROUNDUP(p->sz))
+    return -1;
+
+  v = free;
+  v->addr = top - len;
+  v->len = len;
+  v->prot = prot;
+  v->flags = flags;
+  v->off = off;
+  v->f = filedup(f);
+  return v->addr;
+}
+
+// Write the page at va back to its file if it is dirty,
+// for a shared region, then unmap and free it.
+static void
+unmappage(struct proc *p, struct vma *v, uint64 va)
+{
+  pte_t *pte;
+  uint64 pa;
+  uint off, n, i, n1;
+  int max = log_maxwrite();
+
+  if((pte = walk(p->pagetable, va, 0)) == 0 || (*pte & PTE_V) == 0)
+    return;  // never touched
+  pa = PTE2PA(*pte);
+
+  if(v->flags == MAP_SHARED && (*pte & PTE_D)){
+    off = v->off + (va - v->addr);
+    ilock(v->f->ip);
+    n = v->f->ip->size > off ? v->f->ip->size - off : 0;
+    iunlock(v->f->ip);
+    if(n > PGSIZE)
+      n = PGSIZE;
+    // a few blocks at a time, as in filewrite().
+    for(i = 0; i < n; i += n1){
+      n1 = n - i;
+      if(n1 > max)
+        n1 = max;
+      begin_opn(log_writeblocks(n1));
+      ilock(v->f->ip);
+      writei(v->f->ip, 0, pa + i, off + i, n1);
+      iunlock(v->f->ip);
+      end_op();
+    }
+  }
+
+  kfree((void*)pa);
+  *pte = 0;
+}
+
+// Unmap [addr, addr+len) of region v, which must be at the
+// start or the end of the region (or all of it).
+static int
+unmapvma(struct proc *p, struct vma *v, uint64 addr, uint64 len)
+{
+  uint64 a;
+
+  if(addr != v->addr && addr + len != v->addr + v->len)
+    return -1;  // would split the region
+
+  for(a = addr; a < addr + len; a += PGSIZE)
+    unmappage(p, v, a);
+  uvmflush(p->pagetable);
+  sfence_vma();
+
+  if(len == v->len){
+    fileclose(v->f);
+    v->f = 0;
+  } else if(addr == v->addr){
+    v->addr += len;
+    v->off += len;
+    v->len -= len;
+  } else {
+    v->len -= len;
+  }
+  return 0;
+}
+
+// Remove the mappings for [addr, addr+len), which must lie
+// within a single region. Returns 0 on success, -1 on error.
+int
+munmap(uint64 addr, uint64 len)
+{
+  struct proc *p = myproc();
+  struct vma *v;
+
+  if(addr % PGSIZE != 0 || len == 0)
+    return -1;
+  len = PGROUNDUP(len);
+  if((v = findvma(p, addr)) == 0 || addr + len > v->addr + v->len)
+    return -1;
+  return unmapvma(p, v, addr, len);
+}
+
+// Unmap every region of the current process, writing back
+// shared ones. Called by exit() and exec().
+void
+mmapexit(void)
+{
+  struct proc *p = myproc();
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->f)
+      unmapvma(p, v, v->addr, v->len);
+}
+
+// Handle a fault at va in pagetable, which must be the current
+// process's: read the page in from its file, or make a shared
+// page writable. Returns 0 if va is in a region that allows
+// the access, -1 otherwise.
+int
+mmapfault(pagetable_t pagetable, uint64 va, int write)
+{
+  struct proc *p = myproc();
+  struct vma *v;
+  pte_t *pte;
+  char *mem;
+  int perm;
+  uint off;
+
+  if(p == 0 || pagetable != p->pagetable || (v = findvma(p, va)) == 0)
+    return -1;
+
+  // reading the file may sleep, which is not allowed while
+  // holding a spinlock (as during wait()'s copyout()).
+  push_off();
+  int locked = mycpu()->noff > 1;
+  pop_off();
+  if(locked)
+    return -1;
+
+  if(write ? !(v->prot & PROT_WRITE) : !(v->prot & PROT_READ))
+    return -1;
+  va = PGROUNDDOWN(va);
+
+  if((pte = walk(p->pagetable, va, 0)) != 0 && (*pte & PTE_V)){
+    // store to a shared page that so far was only read.
+    if(!write)
+      return -1;
+    *pte |= PTE_W | PTE_D;
+    uvmflush(p->pagetable);
+    return 0;
+  }
+
+  if((mem = kzalloc()) == 0)
+    return -1;
+  off = v->off + (va - v->addr);
+  ilock(v->f->ip);
+  readi(v->f->ip, 0, (uint64)mem, off, PGSIZE);
+  iunlock(v->f->ip);
+
+  perm = PTE_U;
+  if(v->prot & PROT_READ)
+    perm |= PTE_R;
+  if(v->prot & PROT_WRITE){
+    if(v->flags == MAP_PRIVATE)
+      perm |= PTE_W;
+    else if(write)
+      perm |= PTE_W | PTE_D;
+  }
+  if(mappages(p->pagetable, va, PGSIZE, (uint64)mem, perm) != 0){
+    kfree(mem);
+    return -1;
+  }
+  return 0;
+}
+
+// Fault in the pages of mmap regions in [va, va+len), so that
+// copyin() and copyout() find them present. For callers that
+// copy while holding locks that mmapfault() needs.
+void
+mmaptouch(uint64 va, uint64 len, int write)
+{
+  struct proc *p = myproc();
+  struct vma *v;
+  pte_t *pte;
+  uint64 a, start, end;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->f == 0)
+      continue;
+    start = va > v->addr ? va : v->addr;
+    end = va + len < v->addr + v->len ? va + len : v->addr + v->len;
+    for(a = PGROUNDDOWN(start); a < end; a += PGSIZE){
+      pte = walk(p->pagetable, a, 0);
+      if(pte == 0 || (*pte & PTE_V) == 0 || (write && (*pte & PTE_W) == 0))
+        mmapfault(p->pagetable, a, write);
+    }
+  }
+}
+
+// Give child np copies of p's regions, including the
+// pages p has already faulted in.
+// Returns 0 on success, -1 on failure, leaving np with
+// no regions.
+int
+mmapcopy(struct proc *p, struct proc *np)
+{
+  struct vma *v, *nv;
+  pte_t *pte;
+  uint64 a;
+  char *mem;
+
+  for(v = p->vma, nv = np->vma; v < &p->vma[NVMA]; v++, nv++){
+    if(v->f == 0)
+      continue;
+    *nv = *v;
+    nv->f = filedup(v->f);
+    for(a = v->addr; a < v->addr + v->len; a += PGSIZE){
+      if((pte = walk(p->pagetable, a, 0)) == 0 || (*pte & PTE_V) == 0)
+        continue;
+      if((mem = kalloc()) == 0)
+        goto bad;
+      memmove(mem, (char*)PTE2PA(*pte), PGSIZE);
+      if(mappages(np->pagetable, a, PGSIZE, (uint64)mem, PTE_FLAGS(*pte)) != 0){
+        kfree(mem);
+        goto bad;
+      }
+    }
+  }
+  return 0;
+
+ bad:
+  // drop the copies without writing anything back.
+  for(nv = np->vma; nv < &np->vma[NVMA]; nv++){
+    if(nv->f == 0)
+      continue;
+    for(a = nv->addr; a < nv->addr + nv->len; a += PGSIZE){
+      if((pte = walk(np->pagetable, a, 0)) != 0 && (*pte & PTE_V)){
+        kfree((void*)PTE2PA(*pte));
+        *pte = 0;
+      }
+    }
+    fileclose(nv->f);
+    nv->f = 0;
+  }
+  return -1;
+}
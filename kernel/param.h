@@ -1,13 +1,17 @@
 #define NPROC        64  // maximum number of processes
 #define NCPU          2  // maximum number of CPUs
 #define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
+#define NVMA         16  // mmap regions per process
+#define NUTLB         4  // cached user translations per process
+#define NINODE       50  // active i-nodes usertests expects the kernel to hold
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
-#define MAXOPBLOCKS  10  // max # of blocks any FS op writes
-#define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
+#define MAXOPBLOCKS  12  // max # of blocks an FS op other than a file write writes
+#define LOGSIZE      126 // max data blocks in each half of the on-disk log
+#define BCACHEFRAC   8     // disk block cache may grow to 1/BCACHEFRAC of RAM
+#define NREADAHEAD   16    // blocks readi() reads ahead of sequential reads
+#define NPREALLOC    32    // free blocks set aside for a growing file
+#define FSSIZE       2000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
+#define MAXORDER     10    // largest physical allocation is 2^MAXORDER pages
@@ -27,6 +27,9 @@ struct proc unused_head;
 struct proc sleeping_head;
 struct proc zombie_head;
 
+// read-only to every process at USHARED.
+struct ushared *ushared;
+
 
 extern void forkret(void);
 static void freeproc(struct proc *p);
@@ -140,23 +143,27 @@ procinit(void)
   struct proc *p;
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
+  if((ushared = kzalloc()) == 0)
+    panic("procinit: ushared");
+  // every CPU goes through the list heads, so give their
+  // locks first-come, first-served ticket locks.
   for(struct cpu *cp = cpus ;cp < &cpus[NCPU] ;cp++)
   {
     cp->head_runnable.next = 0;
-    initlock(&cp->head_runnable.l, "proc");
+    initlock_kind(&cp->head_runnable.l, "proc", LOCK_TICKET);
   }
   
-  initlock(&unused_head.l, "unused");
+  initlock_kind(&unused_head.l, "unused", LOCK_TICKET);
   acquire(&unused_head.lock);
   unused_head.next = NULL;
   release(&unused_head.lock);
 
-  initlock(&sleeping_head.l, "sleeping");
+  initlock_kind(&sleeping_head.l, "sleeping", LOCK_TICKET);
   acquire(&sleeping_head.lock);
   sleeping_head.next = NULL;
   release(&sleeping_head.lock);
 
-  initlock(&zombie_head.l, "zombie");
+  initlock_kind(&zombie_head.l, "zombie", LOCK_TICKET);
   acquire(&zombie_head.lock);
   zombie_head.next = NULL;
   release(&zombie_head.lock);
@@ -260,6 +267,13 @@ found:
     return 0;
   }
 
+  // Allocate the page user code reads the pid and cpu from.
+  if((p->usyscall = (struct usyscall *)kzalloc()) == 0){
+    freeproc(p);
+    release(&p->lock);
+    return 0;
+  }
+  p->usyscall->pid = p->pid;
 
   // An empty user page table.
   p->pagetable = proc_pagetable(p);
@@ -287,9 +301,15 @@ freeproc(struct proc *p)
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
-  if(p->pagetable)
+  if(p->usyscall)
+    kfree((void*)p->usyscall);
+  p->usyscall = 0;
+  if(p->pagetable){
+    uringfree(p);
     proc_freepagetable(p->pagetable, p->sz);
+  }
   p->pagetable = 0;
+  memset(p->tlb, 0, sizeof(p->tlb));
   p->sz = 0;
   p->pid = 0;
   p->parent = 0;
@@ -297,6 +317,7 @@ freeproc(struct proc *p)
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
+  p->tracemask = 0;
   p->state = UNUSED;
 
 
@@ -343,6 +364,24 @@ proc_pagetable(struct proc *p)
     return 0;
   }
 
+  // map the read-only pages that let user/ulib.c answer
+  // getpid() and friends without a trap.
+  if(mappages(pagetable, USYSCALL, PGSIZE,
+              (uint64)(p->usyscall), PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+  if(mappages(pagetable, USHARED, PGSIZE,
+              (uint64)ushared, PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, USYSCALL, 1, 0);
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+
   return pagetable;
 }
 
@@ -353,6 +392,8 @@ proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
   uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  uvmunmap(pagetable, USYSCALL, 1, 0);
+  uvmunmap(pagetable, USHARED, 1, 0);
   uvmfree(pagetable, sz);
 }
 
@@ -395,7 +436,7 @@ userinit(void)
   {
     #if ON
     // uint64 count = cpus[0].counter;
-    while(cas(&cpus[0].counter,cpus[0].counter,cpus[0].counter + 1));
+    runq_add(0, 1);
     #endif
 
     add_to_list(&cpus[0].head_runnable, p);
@@ -418,6 +459,8 @@ growproc(int n)
 
   sz = p->sz;
   if(n > 0){
+    if(sz + (uint64)n > mmapbase(p))
+      return -1;  // would run into an mmap region
     if((sz = uvmalloc(p->pagetable, sz, sz + n)) == 0) {
       return -1;
     }
@@ -450,6 +493,13 @@ fork(void)
   }
   np->sz = p->sz;
 
+  // Copy mmap regions.
+  if(mmapcopy(p, np) < 0){
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
 
@@ -463,6 +513,7 @@ fork(void)
   np->cwd = idup(p->cwd);
 
   safestrcpy(np->name, p->name, sizeof(p->name));
+  np->tracemask = p->tracemask;
 
   pid = np->pid;
 
@@ -483,7 +534,7 @@ fork(void)
   // printf("the current cpu is: %d, and the min cpu is: %d\n", get_cpu(), cpu_id);
   struct cpu *cp = &cpus[cpu_id];
   // uint64 count = cp->counter;
-  while(cas(&cp->counter,cp->counter, cp->counter + 1));
+  runq_add(cpu_id, 1);
   #else 
   struct cpu *cp  = mycpu();
   int cpu_id = -1;
@@ -528,6 +579,9 @@ exit(int status)
   if(p == initproc)
     panic("init exiting");
 
+  // Write back and remove mmap regions.
+  mmapexit();
+
   // Close all open files.
   for(int fd = 0; fd < NOFILE; fd++){
     if(p->ofile[fd]){
@@ -655,15 +709,18 @@ scheduler(void)
         remove_from_list(&c->head_runnable,node);
         #if ON
         // uint64 count = c->counter;
-        while(cas(&c->counter,c->counter,c->counter -1));
+        runq_add(cpuid(), -1);
         #endif
         // printf("%s%d\n","pid =   ", node->pid);
         node->state = RUNNING;
         c->proc = node;
+        node->usyscall->cpu = cpuid();
+        uvmmirror(node->pagetable);
 
         //node->last_cpu = get_cpu();
         swtch(&c->context, &node->context);
         c->proc = 0;
+        uvmmirror(0);
 
         if (node!=NULL)
         {
@@ -671,6 +728,9 @@ scheduler(void)
 
         }
         
+    } else {
+      // nothing to run; get ahead on zeroing free pages.
+      kzeroidle();
     }
 
 
@@ -847,7 +907,7 @@ wakeup(void *chan)
       #elif ON
       int cpu_id = get_min_cpu();
       // int count = cpus[cpu_id].counter;
-      while(cas(&cpus[cpu_id].counter,cpus[cpu_id].counter, cpus[cpu_id].counter+1)){}
+      runq_add(cpu_id, 1);
       
       // printf("the current cpu is: %d, and the min cpu is: %d\n", get_cpu(), cpu_id);
       #else 
@@ -900,7 +960,7 @@ kill(int pid)
         struct cpu* c =& cpus[id];
         #if ON
         // uint64 count = cpus[id].counter;
-        while(cas(&cpus[id].counter,cpus[id].counter,cpus[id].counter + 1));
+        runq_add(id, 1);
         #endif
         add_to_list(&c->head_runnable, p);
         p->state = RUNNABLE;
@@ -972,6 +1032,20 @@ cpu_process_count(int cpu_num){
   return ans;
   }
 
+// Add delta to cpu's count of runnable processes, and
+// publish the new count in ushared.
+void
+runq_add(int cpu, int delta)
+{
+  struct cpu *c = &cpus[cpu];
+  int n;
+
+  while(cas(&c->counter, c->counter, c->counter + delta));
+  do{
+    n = ushared->runq[cpu];
+  } while(cas(&ushared->runq[cpu], n, n + delta));
+}
+
 int 
 get_min_cpu(){
   
@@ -1,3 +1,19 @@
+// A region of a process's address space mapped by mmap().
+struct vma {
+  uint64 addr;       // page-aligned start
+  uint64 len;        // page-aligned length
+  int prot;          // PROT_READ, PROT_WRITE
+  int flags;         // MAP_SHARED or MAP_PRIVATE
+  struct file *f;    // mapped file; 0 if the slot is free
+  uint off;          // file offset of addr
+};
+
+// A cached user translation; see uvmaddr() in vm.c.
+struct utlb {
+  uint64 va;         // page-aligned user address
+  pte_t pte;         // its PTE; 0 if the entry is empty
+};
+
 // Saved registers for kernel context switches.
 struct context {
   uint64 ra;
@@ -99,9 +115,16 @@ struct proc {
   uint64 sz;                   // Size of process memory (bytes)
   pagetable_t pagetable;       // User page table
   struct trapframe *trapframe; // data page for trampoline.S
+  struct usyscall *usyscall;   // read-only page for user/ulib.c
   struct context context;      // swtch() here to run process
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
+  struct vma vma[NVMA];        // mmap regions
+  struct utlb tlb[NUTLB];      // recent translations for copyin/copyout
+  int tlbnext;                 // next tlb[] entry to replace
+  struct uring *uring;         // system call ring at URING, or 0
+  uint64 tracemask;            // system calls to trace (1 << SYS_*)
+  int logres;                  // log blocks reserved by begin_op()
   char name[16];               // Process name (debugging)
 };
 
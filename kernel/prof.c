@@ -0,0 +1,141 @@
+//
+// Sampling profiler.
+//
+// While profiling is on, every timer interrupt on every CPU
+// records the pc it interrupted in that CPU's ring of samples,
+// overwriting the oldest once the ring is full. To get more
+// than the ten samples per second that clock ticks give,
+// profiling also makes the timer interrupt PROFRATE times per
+// tick; proftick() tells devintr() which interrupts are real
+// clock ticks.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "proc.h"
+#include "defs.h"
+#include "prof.h"
+
+#define NSAMPLE 1024  // samples per CPU
+#define PROFRATE 10   // timer interrupts per clock tick while profiling
+
+struct profcpu {
+  struct spinlock lock;
+  struct profsample buf[NSAMPLE];
+  uint head;          // next slot to fill
+  uint n;             // valid samples, ending at head
+  int sub;            // timer interrupts since the last clock tick
+};
+
+static struct profcpu profcpus[NCPU];
+static volatile int profon;
+static volatile int profrate = 1;
+
+extern uint64 timer_scratch[NCPU][5];
+
+void
+profinit(void)
+{
+  for(int i = 0; i < NCPU; i++)
+    initlock(&profcpus[i].lock, "prof");
+}
+
+// Called by devintr() on each timer interrupt, with interrupts
+// off. Records a sample if profiling is on. Returns 1 if this
+// interrupt is also a clock tick.
+int
+proftick(void)
+{
+  struct profcpu *pc = &profcpus[cpuid()];
+  struct profsample *s;
+  struct proc *p;
+
+  if(profon){
+    p = mycpu()->proc;
+    acquire(&pc->lock);
+    s = &pc->buf[pc->head % NSAMPLE];
+    s->pc = r_sepc();
+    s->pid = p ? p->pid : 0;
+    s->user = (r_sstatus() & SSTATUS_SPP) == 0;
+    pc->head++;
+    if(pc->n < NSAMPLE)
+      pc->n++;
+    release(&pc->lock);
+  }
+
+  if(++pc->sub < profrate)
+    return 0;
+  pc->sub = 0;
+  return 1;
+}
+
+// Set every CPU's timer to interrupt rate times per tick.
+// Each CPU picks up the new interval at its next interrupt.
+static void
+setrate(int rate)
+{
+  profrate = rate;
+  for(int i = 0; i < NCPU; i++)
+    timer_scratch[i][4] = TICKINTERVAL / rate;
+}
+
+// Copy out the buffered samples, oldest first on each CPU,
+// to user address addr, at most max of them.
+// Returns the number copied, or -1.
+static int
+profread(uint64 addr, int max)
+{
+  struct profsample tmp[16];
+  struct profcpu *pc;
+  int n, total;
+
+  total = 0;
+  for(pc = profcpus; pc < &profcpus[NCPU]; pc++){
+    for(;;){
+      acquire(&pc->lock);
+      for(n = 0; n < NELEM(tmp) && pc->n > 0 && total + n < max; n++){
+        tmp[n] = pc->buf[(pc->head - pc->n) % NSAMPLE];
+        pc->n--;
+      }
+      release(&pc->lock);
+      if(n == 0)
+        break;
+      if(copyout(myproc()->pagetable, addr + total*sizeof(tmp[0]),
+                 (char*)tmp, n*sizeof(tmp[0])) < 0)
+        return -1;
+      total += n;
+    }
+  }
+  return total;
+}
+
+// Start, stop or read the profiler.
+int
+prof(int cmd, uint64 addr, int n)
+{
+  struct profcpu *pc;
+
+  switch(cmd){
+  case PROF_START:
+    for(pc = profcpus; pc < &profcpus[NCPU]; pc++){
+      acquire(&pc->lock);
+      pc->n = 0;
+      release(&pc->lock);
+    }
+    setrate(PROFRATE);
+    profon = 1;
+    return 0;
+  case PROF_STOP:
+    profon = 0;
+    setrate(1);
+    return 0;
+  case PROF_READ:
+    if(n < 0)
+      return -1;
+    return profread(addr, n);
+  }
+  return -1;
+}
@@ -0,0 +1,11 @@
+// Sampling profiler requests, for prof().
+#define PROF_START 1  // clear the sample buffers and start sampling
+#define PROF_STOP  2  // stop sampling
+#define PROF_READ  3  // copy out and remove the buffered samples
+
+// One sample: where a CPU was when its timer interrupted it.
+struct profsample {
+  uint64 pc;         // sepc of the interrupted code
+  int pid;           // process running on the CPU, or 0
+  int user;          // 1 if pc is a user address
+};
@@ -40,6 +40,7 @@ w_mepc(uint64 x)
 
 // Supervisor Status Register, sstatus
 
+#define SSTATUS_SUM (1L << 18) // Supervisor may access User pages
 #define SSTATUS_SPP (1L << 8)  // Previous mode, 1=Supervisor, 0=User
 #define SSTATUS_SPIE (1L << 5) // Supervisor Previous Interrupt Enable
 #define SSTATUS_UPIE (1L << 4) // User Previous Interrupt Enable
@@ -260,7 +261,33 @@ r_mcounteren()
   return x;
 }
 
-// machine-mode cycle counter
+// Supervisor-mode Counter-Enable
+static inline void
+w_scounteren(uint64 x)
+{
+  asm volatile("csrw scounteren, %0" : : "r" (x));
+}
+
+static inline uint64
+r_scounteren()
+{
+  uint64 x;
+  asm volatile("csrr %0, scounteren" : "=r" (x) );
+  return x;
+}
+
+// cycle counter.
+// readable from supervisor mode once mcounteren.CY is set.
+static inline uint64
+r_cycle()
+{
+  uint64 x;
+  asm volatile("csrr %0, cycle" : "=r" (x) );
+  return x;
+}
+
+// real-time counter (10 MHz under qemu's virt machine).
+// readable from supervisor mode once mcounteren.TM is set.
 static inline uint64
 r_time()
 {
@@ -343,6 +370,8 @@ sfence_vma()
 #define PTE_W (1L << 2)
 #define PTE_X (1L << 3)
 #define PTE_U (1L << 4) // 1 -> user can access
+#define PTE_A (1L << 6)
+#define PTE_D (1L << 7) // page has been written
 
 // shift a physical address to the right place for a PTE.
 #define PA2PTE(pa) ((((uint64)pa) >> 12) << 10)
@@ -351,11 +380,19 @@ sfence_vma()
 
 #define PTE_FLAGS(pte) ((pte) & 0x3FF)
 
+// a valid PTE with any of R/W/X set is a leaf; otherwise it
+// points to the next level of the page table.
+#define PTE_LEAF(pte) ((pte) & (PTE_R|PTE_W|PTE_X))
+
 // extract the three 9-bit page table indices from a virtual address.
 #define PXMASK          0x1FF // 9 bits
 #define PXSHIFT(level)  (PGSHIFT+(9*(level)))
 #define PX(level, va) ((((uint64) (va)) >> PXSHIFT(level)) & PXMASK)
 
+// bytes mapped by one leaf PTE at a given level:
+// 4 KiB page (0), 2 MiB megapage (1), 1 GiB gigapage (2).
+#define LEVELSIZE(level) (1L << PXSHIFT(level))
+
 // one beyond the highest possible virtual address.
 // MAXVA is actually one bit less than the max allowed by
 // Sv39, to avoid having to sign-extend virtual addresses
@@ -0,0 +1,9 @@
+// Statistics for one system call, as reported by scstats().
+// Times are in TIMEFREQ ticks (see memlayout.h), measured from
+// entry to return, so they include time spent sleeping.
+struct scstat {
+  uint64 count;      // number of calls
+  uint64 time;       // total time in the call
+  uint64 max;        // longest single call
+  char name[24];     // the call's name, or "" if there is none
+};
@@ -0,0 +1,214 @@
+// Slab allocator for small kernel objects.
+//
+// Each kmem_cache hands out objects of a single size, carved
+// out of whole pages ("slabs") obtained from kalloc(). A slab
+// page starts with a struct slab header, followed by as many
+// objects as fit; its free objects are chained through their
+// first word. Slabs with free objects sit on the cache's
+// partial list, and a slab is given back to kalloc() as soon
+// as all of its objects are free.
+//
+// In front of the slabs, each CPU has a magazine: a small
+// stack of free objects that kmem_cache_alloc() and
+// kmem_cache_free() use without touching the cache lock.
+// Only when its magazine runs empty (or full) does a CPU lock
+// the cache and move half a magazine's worth of objects from
+// (or to) the slabs. The magazine's own lock is uncontended
+// except when kmem_cache_reap() drains every CPU's magazine
+// to give memory back under pressure.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "slab.h"
+#include "defs.h"
+
+struct slab {
+  struct slab *next;  // cache's partial list
+  struct slab *prev;
+  struct kmem_cache *cache;
+  void *freelist;     // free objects in this slab
+  uint nfree;
+};
+
+#define SLABHDR ((sizeof(struct slab) + 7) & ~7)
+
+#define NCACHE 16
+
+// all caches, for kmem_cache_reap().
+static struct kmem_cache *caches[NCACHE];
+static int ncache;
+
+// Set up an empty cache of size-byte objects.
+// Only called during boot, before other CPUs start.
+void
+kmem_cache_init(struct kmem_cache *c, char *name, uint size)
+{
+  size = (size + 7) & ~7;
+  if(size < sizeof(void*) || SLABHDR + size > PGSIZE)
+    panic("kmem_cache_init: size");
+  if(ncache >= NCACHE)
+    panic("kmem_cache_init: too many caches");
+
+  initlock(&c->lock, name);
+  c->name = name;
+  c->size = size;
+  c->perslab = (PGSIZE - SLABHDR) / size;
+  c->partial = 0;
+  c->nslab = 0;
+  for(int i = 0; i < NCPU; i++){
+    initlock(&c->mag[i].lock, "magazine");
+    c->mag[i].n = 0;
+  }
+  caches[ncache++] = c;
+}
+
+static void
+slab_link(struct kmem_cache *c, struct slab *s)
+{
+  s->prev = 0;
+  s->next = c->partial;
+  if(c->partial)
+    c->partial->prev = s;
+  c->partial = s;
+}
+
+static void
+slab_unlink(struct kmem_cache *c, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    c->partial = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+  s->next = s->prev = 0;
+}
+
+// Take one free object from the slabs, growing the cache by
+// a page if none has a free object. Caller holds c->lock.
+static void *
+slab_get(struct kmem_cache *c)
+{
+  struct slab *s;
+  char *p;
+  void *obj;
+
+  if((s = c->partial) == 0){
+    if((s = (struct slab*)kalloc()) == 0)
+      return 0;
+    s->cache = c;
+    s->freelist = 0;
+    for(p = (char*)s + SLABHDR; p + c->size <= (char*)s + PGSIZE; p += c->size){
+      *(void**)p = s->freelist;
+      s->freelist = p;
+    }
+    s->nfree = c->perslab;
+    c->nslab++;
+    slab_link(c, s);
+  }
+
+  obj = s->freelist;
+  s->freelist = *(void**)obj;
+  if(--s->nfree == 0)
+    slab_unlink(c, s);
+  return obj;
+}
+
+// Return one object to its slab, and the slab's page to
+// kalloc() if that was its last object in use.
+// Returns 1 if the page went back, 0 if not.
+// Caller holds c->lock.
+static int
+slab_put(struct kmem_cache *c, void *obj)
+{
+  struct slab *s = (struct slab*)PGROUNDDOWN((uint64)obj);
+
+  if(s->cache != c)
+    panic("kmem_cache_free: wrong cache");
+  *(void**)obj = s->freelist;
+  s->freelist = obj;
+  if(s->nfree++ == 0)
+    slab_link(c, s);
+  if(s->nfree == c->perslab){
+    slab_unlink(c, s);
+    c->nslab--;
+    kfree((void*)s);
+    return 1;
+  }
+  return 0;
+}
+
+// Allocate an object from cache c.
+// Its contents are undefined.
+// Returns 0 if the memory cannot be allocated.
+void *
+kmem_cache_alloc(struct kmem_cache *c)
+{
+  struct magazine *m;
+  void *obj;
+
+  push_off();
+  m = &c->mag[cpuid()];
+  acquire(&m->lock);
+  if(m->n == 0){
+    acquire(&c->lock);
+    while(m->n < MAGSIZE/2 && (obj = slab_get(c)) != 0)
+      m->obj[m->n++] = obj;
+    release(&c->lock);
+  }
+  obj = 0;
+  if(m->n > 0)
+    obj = m->obj[--m->n];
+  release(&m->lock);
+  pop_off();
+  return obj;
+}
+
+// Give an object back to cache c.
+void
+kmem_cache_free(struct kmem_cache *c, void *obj)
+{
+  struct magazine *m;
+
+  push_off();
+  m = &c->mag[cpuid()];
+  acquire(&m->lock);
+  if(m->n == MAGSIZE){
+    acquire(&c->lock);
+    while(m->n > MAGSIZE/2)
+      slab_put(c, m->obj[--m->n]);
+    release(&c->lock);
+  }
+  m->obj[m->n++] = obj;
+  release(&m->lock);
+  pop_off();
+}
+
+// Empty every CPU's magazines back into the slabs, so that
+// slabs with no objects in use return their pages to kalloc().
+// Called by kalloc() when it runs out of memory; the caller
+// must not hold any cache or magazine lock.
+// Returns the number of pages freed.
+int
+kmem_cache_reap(void)
+{
+  struct kmem_cache *c;
+  struct magazine *m;
+  int freed = 0;
+
+  for(int i = 0; i < ncache; i++){
+    c = caches[i];
+    for(m = c->mag; m < &c->mag[NCPU]; m++){
+      acquire(&m->lock);
+      acquire(&c->lock);
+      while(m->n > 0)
+        freed += slab_put(c, m->obj[--m->n]);
+      release(&c->lock);
+      release(&m->lock);
+    }
+  }
+  return freed;
+}
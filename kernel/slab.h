@@ -0,0 +1,20 @@
+// Object caches for small kernel objects; see slab.c.
+
+#define MAGSIZE 16  // objects in each per-CPU magazine
+
+// A per-CPU stack of free objects in front of the slabs.
+struct magazine {
+  struct spinlock lock;  // only contended by kmem_cache_reap()
+  int n;
+  void *obj[MAGSIZE];
+};
+
+struct kmem_cache {
+  struct spinlock lock;  // protects the slab lists below
+  char *name;
+  uint size;             // object size, rounded up to 8 bytes
+  uint perslab;          // objects per slab page
+  struct slab *partial;  // slabs with at least one free object
+  int nslab;             // slab pages in use
+  struct magazine mag[NCPU];
+};
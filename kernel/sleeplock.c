@@ -51,5 +51,65 @@ holdingsleep(struct sleeplock *lk)
   return r;
 }
 
+void
+initrwsleeplock(struct rwsleeplock *lk, char *name)
+{
+  initlock(&lk->lk, "sleep lock");
+  lk->name = name;
+  lk->readers = 0;
+  lk->wwait = 0;
+  lk->writer = 0;
+}
+
+void
+acquirereadsleep(struct rwsleeplock *lk)
+{
+  acquire(&lk->lk);
+  while(lk->writer || lk->wwait)
+    sleep(lk, &lk->lk);
+  lk->readers++;
+  release(&lk->lk);
+}
 
+void
+releasereadsleep(struct rwsleeplock *lk)
+{
+  acquire(&lk->lk);
+  if(lk->readers < 1)
+    panic("releasereadsleep");
+  if(--lk->readers == 0)
+    wakeup(lk);
+  release(&lk->lk);
+}
 
+void
+acquirewritesleep(struct rwsleeplock *lk)
+{
+  acquire(&lk->lk);
+  lk->wwait++;
+  while(lk->writer || lk->readers)
+    sleep(lk, &lk->lk);
+  lk->wwait--;
+  lk->writer = myproc()->pid;
+  release(&lk->lk);
+}
+
+void
+releasewritesleep(struct rwsleeplock *lk)
+{
+  acquire(&lk->lk);
+  lk->writer = 0;
+  wakeup(lk);
+  release(&lk->lk);
+}
+
+int
+holdingwritesleep(struct rwsleeplock *lk)
+{
+  int r;
+
+  acquire(&lk->lk);
+  r = lk->writer == myproc()->pid;
+  release(&lk->lk);
+  return r;
+}
@@ -8,3 +8,15 @@ struct sleeplock {
   int pid;           // Process holding lock
 };
 
+// Readers-writer sleep lock: any number of processes may hold
+// it shared, or one exclusively. Waiting writers hold off new
+// readers.
+struct rwsleeplock {
+  struct spinlock lk; // spinlock protecting this lock
+  int readers;        // processes holding it shared
+  int wwait;          // processes waiting to hold it exclusively
+  int writer;         // pid of the exclusive holder, or 0
+
+  // For debugging:
+  char *name;         // Name of lock.
+};
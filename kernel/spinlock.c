@@ -1,4 +1,16 @@
 // Mutual exclusion spin locks.
+//
+// Three kinds (see spinlock.h), chosen per lock with
+// initlock_kind(), or for all other locks with LOCKFLG:
+// test-and-set, where every waiter hammers lk->locked and
+// whichever CPU swaps first wins; ticket, where waiters are
+// served in arrival order but all watch lk->serving; and MCS,
+// where waiters queue up and each spins on its own node, so
+// that handing the lock over touches only the next waiter.
+//
+// A CPU holds no more than NMCSNODE MCS locks at once; the
+// nodes come from a per-CPU pool, which is safe because a
+// spinlock is always released on the CPU that acquired it.
 
 #include "types.h"
 #include "param.h"
@@ -7,30 +19,214 @@
 #include "riscv.h"
 #include "proc.h"
 #include "defs.h"
+#include "lockstat.h"
+
+// Locks are counted by name: all the "proc" locks, say, share
+// one lockclass. Each CPU counts in its own slot, with
+// interrupts off, so counting takes no atomic operations.
+#define NLOCKCLASS 64
+
+struct lockclass {
+  char *name;
+  struct {
+    uint64 nacquire;
+    uint64 ncontend;
+    uint64 spin;
+  } cpu[NCPU];
+};
+
+static struct lockclass classes[NLOCKCLASS];
+static int nclass;
+static struct spinlock classlock;  // no class of its own
+
+// initlock() runs on allocation paths (pipes, inodes, buffers),
+// so lockclass() finds a name's class by the address of the
+// name string in a hash table that is read without locking.
+// Entries are only ever added, under classlock, with the
+// class stored before the name that publishes it.
+#define NCLASSHASH 256
+
+static struct {
+  char *name;
+  struct lockclass *class;
+} classhash[NCLASSHASH];
+
+#define NMCSNODE 16
+
+static struct mcsnode mcsnodes[NCPU][NMCSNODE];
+static uint mcsused[NCPU];  // bit i set if mcsnodes[cpu][i] is in use
+
+// Find or make the class for locks named name.
+static struct lockclass*
+lockclass(char *name)
+{
+  struct lockclass *c;
+  char *n;
+  int h, i;
+
+  h = ((uint64)name >> 3) % NCLASSHASH;
+  for(i = 0; i < NCLASSHASH; i++){
+    n = __atomic_load_n(&classhash[(h + i) % NCLASSHASH].name, __ATOMIC_ACQUIRE);
+    if(n == name)
+      return classhash[(h + i) % NCLASSHASH].class;
+    if(n == 0)
+      break;
+  }
+
+  // first lock with this name string: match it by contents.
+  acquire(&classlock);
+  for(c = classes; c < &classes[nclass]; c++)
+    if(c->name == name || strncmp(c->name, name, 16) == 0)
+      goto found;
+  if(nclass == NLOCKCLASS){
+    c = 0;  // not counted
+    goto found;
+  }
+  c = &classes[nclass++];
+  c->name = name;
+ found:
+  for(i = 0; i < NCLASSHASH; i++){
+    n = classhash[(h + i) % NCLASSHASH].name;
+    if(n == name)
+      break;
+    if(n == 0){
+      classhash[(h + i) % NCLASSHASH].class = c;
+      __atomic_store_n(&classhash[(h + i) % NCLASSHASH].name, name, __ATOMIC_RELEASE);
+      break;
+    }
+  }
+  release(&classlock);
+  return c;
+}
 
 void
-initlock(struct spinlock *lk, char *name)
+initlock_kind(struct spinlock *lk, char *name, int kind)
 {
   lk->name = name;
   lk->locked = 0;
+  lk->kind = kind;
+  lk->ticket = 0;
+  lk->serving = 0;
+  lk->tail = 0;
+  lk->node = 0;
   lk->cpu = 0;
+  lk->class = lockclass(name);
 }
 
-// Acquire the lock.
-// Loops (spins) until the lock is acquired.
 void
-acquire(struct spinlock *lk)
+initlock(struct spinlock *lk, char *name)
 {
-  push_off(); // disable interrupts to avoid deadlock.
-  if(holding(lk))
-    panic("acquire");
+  initlock_kind(lk, name, LOCKKIND);
+}
+
+// The kind-specific halves of acquire(). Each returns 0 if it
+// got the lock straight away, or 1 after waiting for it, with
+// the cycles spent waiting in *spin.
+
+static int
+tas_acquire(struct spinlock *lk, uint64 *spin)
+{
+  uint64 t0;
 
   // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
   //   a5 = 1
   //   s1 = &lk->locked
   //   amoswap.w.aq a5, a5, (s1)
+  if(__sync_lock_test_and_set(&lk->locked, 1) == 0)
+    return 0;
+  t0 = r_cycle();
   while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
     ;
+  *spin = r_cycle() - t0;
+  return 1;
+}
+
+static int
+ticket_acquire(struct spinlock *lk, uint64 *spin)
+{
+  uint64 t0;
+  uint my;
+
+  // amoadd.w
+  my = __sync_fetch_and_add(&lk->ticket, 1);
+  if(lk->serving == my){
+    lk->locked = 1;
+    return 0;
+  }
+  t0 = r_cycle();
+  while(lk->serving != my)
+    ;
+  lk->locked = 1;
+  *spin = r_cycle() - t0;
+  return 1;
+}
+
+static int
+mcs_acquire(struct spinlock *lk, uint64 *spin)
+{
+  struct mcsnode *n, *prev;
+  uint64 t0;
+  int id = cpuid();
+  int i;
+
+  for(i = 0; i < NMCSNODE; i++)
+    if((mcsused[id] & (1 << i)) == 0)
+      break;
+  if(i == NMCSNODE)
+    panic("acquire: out of mcs nodes");
+  mcsused[id] |= 1 << i;
+  n = &mcsnodes[id][i];
+  n->next = 0;
+  n->wait = 1;
+
+  // join the queue with an atomic swap (amoswap.d.aqrl). The
+  // release half makes the stores above visible before any
+  // other CPU can find n, so that a predecessor's handoff
+  // (n->wait = 0) or a successor's link (n->next) cannot be
+  // overwritten by them.
+  prev = __atomic_exchange_n(&lk->tail, n, __ATOMIC_ACQ_REL);
+  if(prev){
+    t0 = r_cycle();
+    prev->next = n;
+    while(n->wait)
+      ;
+    *spin = r_cycle() - t0;
+  }
+  lk->node = n;
+  lk->locked = 1;
+  return prev != 0;
+}
+
+// Acquire the lock.
+// Loops (spins) until the lock is acquired.
+void
+acquire(struct spinlock *lk)
+{
+  uint64 spin = 0;
+  int contended;
+
+  push_off(); // disable interrupts to avoid deadlock.
+  if(holding(lk))
+    panic("acquire");
+
+  switch(lk->kind){
+  case LOCK_TICKET:
+    contended = ticket_acquire(lk, &spin);
+    break;
+  case LOCK_MCS:
+    contended = mcs_acquire(lk, &spin);
+    break;
+  default:
+    contended = tas_acquire(lk, &spin);
+    break;
+  }
+  if(lk->class){
+    lk->class->cpu[cpuid()].nacquire++;
+    if(contended){
+      lk->class->cpu[cpuid()].ncontend++;
+      lk->class->cpu[cpuid()].spin += spin;
+    }
+  }
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -42,6 +238,30 @@ acquire(struct spinlock *lk)
   lk->cpu = mycpu();
 }
 
+// Hand an MCS lock to the next waiter, if any, and
+// give back this CPU's queue node.
+static void
+mcs_release(struct spinlock *lk)
+{
+  struct mcsnode *n = lk->node;
+  int id = cpuid();
+
+  lk->node = 0;
+  lk->locked = 0;
+  __sync_synchronize();
+  if(n->next == 0){
+    // no known waiter: try to mark the lock free, unless
+    // someone is just now joining the queue.
+    if(__sync_bool_compare_and_swap(&lk->tail, n, 0))
+      goto out;
+    while(n->next == 0)
+      ;
+  }
+  n->next->wait = 0;
+ out:
+  mcsused[id] &= ~(1 << (n - mcsnodes[id]));
+}
+
 // Release the lock.
 void
 release(struct spinlock *lk)
@@ -59,14 +279,27 @@ release(struct spinlock *lk)
   // On RISC-V, this emits a fence instruction.
   __sync_synchronize();
 
-  // Release the lock, equivalent to lk->locked = 0.
-  // This code doesn't use a C assignment, since the C standard
-  // implies that an assignment might be implemented with
-  // multiple store instructions.
-  // On RISC-V, sync_lock_release turns into an atomic swap:
-  //   s1 = &lk->locked
-  //   amoswap.w zero, zero, (s1)
-  __sync_lock_release(&lk->locked);
+  switch(lk->kind){
+  case LOCK_TICKET:
+    // only the holder writes serving.
+    lk->locked = 0;
+    __sync_synchronize();
+    lk->serving = lk->serving + 1;
+    break;
+  case LOCK_MCS:
+    mcs_release(lk);
+    break;
+  default:
+    // Release the lock, equivalent to lk->locked = 0.
+    // This code doesn't use a C assignment, since the C standard
+    // implies that an assignment might be implemented with
+    // multiple store instructions.
+    // On RISC-V, sync_lock_release turns into an atomic swap:
+    //   s1 = &lk->locked
+    //   amoswap.w zero, zero, (s1)
+    __sync_lock_release(&lk->locked);
+    break;
+  }
 
   pop_off();
 }
@@ -108,3 +341,91 @@ pop_off(void)
   if(c->noff == 0 && c->intena)
     intr_on();
 }
+
+// Readers-writer spin locks. Like acquire(), these keep
+// interrupts off while the lock is held.
+
+void
+initrwlock(struct rwspinlock *lk, char *name)
+{
+  lk->name = name;
+  lk->n = 0;
+  lk->wwait = 0;
+}
+
+void
+acquireread(struct rwspinlock *lk)
+{
+  int n;
+
+  push_off();
+  for(;;){
+    n = lk->n;
+    if(n >= 0 && lk->wwait == 0 && __sync_bool_compare_and_swap(&lk->n, n, n + 1))
+      break;
+  }
+  __sync_synchronize();
+}
+
+void
+releaseread(struct rwspinlock *lk)
+{
+  if(lk->n <= 0)
+    panic("releaseread");
+  __sync_synchronize();
+  __sync_fetch_and_sub(&lk->n, 1);
+  pop_off();
+}
+
+void
+acquirewrite(struct rwspinlock *lk)
+{
+  push_off();
+  __sync_fetch_and_add(&lk->wwait, 1);
+  while(!__sync_bool_compare_and_swap(&lk->n, 0, -1))
+    ;
+  __sync_fetch_and_sub(&lk->wwait, 1);
+  __sync_synchronize();
+}
+
+void
+releasewrite(struct rwspinlock *lk)
+{
+  if(lk->n != -1)
+    panic("releasewrite");
+  __sync_synchronize();
+  lk->n = 0;
+  pop_off();
+}
+
+// Copy the statistics of the first n lock classes to user
+// address addr, clearing them if reset is set.
+// Returns the number of lock classes, or -1.
+int
+lockstat(uint64 addr, int n, int reset)
+{
+  struct lockstat st;
+  struct lockclass *c;
+  int i, nc;
+
+  acquire(&classlock);
+  nc = nclass;
+  release(&classlock);
+
+  if(n > nc)
+    n = nc;
+  for(c = classes; c < &classes[n]; c++){
+    memset(&st, 0, sizeof(st));
+    safestrcpy(st.name, c->name, sizeof(st.name));
+    for(i = 0; i < NCPU; i++){
+      st.nacquire += c->cpu[i].nacquire;
+      st.ncontend += c->cpu[i].ncontend;
+      st.spin += c->cpu[i].spin;
+    }
+    if(copyout(myproc()->pagetable, addr + (c - classes)*sizeof(st), (char*)&st, sizeof(st)) < 0)
+      return -1;
+    if(reset)
+      memset(c->cpu, 0, sizeof(c->cpu));
+  }
+  return nc;
+}
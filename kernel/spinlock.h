@@ -1,9 +1,41 @@
+// Kinds of spinlock, for initlock_kind().
+#define LOCK_TAS    0  // test-and-set: cheapest, but unfair
+#define LOCK_TICKET 1  // ticket: first come, first served
+#define LOCK_MCS    2  // MCS queue: first come, first served, and
+                       // each waiter spins on its own cache line
+
+// The kind initlock() uses; see LOCKFLG in the Makefile.
+#ifndef LOCKKIND
+#define LOCKKIND LOCK_TAS
+#endif
+
+// A waiting CPU's place in an MCS lock's queue.
+// Padded so that waiters on different CPUs spin on
+// different cache lines.
+struct mcsnode {
+  struct mcsnode *volatile next;
+  volatile int wait;
+} __attribute__((aligned(64)));
+
 // Mutual exclusion lock.
 struct spinlock {
   uint locked;       // Is the lock held?
+  int kind;          // LOCK_TAS, LOCK_TICKET or LOCK_MCS
+  uint ticket;       // LOCK_TICKET: next ticket to hand out
+  volatile uint serving; // LOCK_TICKET: ticket now holding the lock
+  struct mcsnode *tail;  // LOCK_MCS: last waiter, or 0 if free
+  struct mcsnode *node;  // LOCK_MCS: the holder's queue node
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
+  struct lockclass *class; // Statistics, shared by locks of the same name.
 };
 
+// Readers-writer spin lock: any number of readers at once,
+// or a single writer. Waiting writers hold off new readers.
+struct rwspinlock {
+  volatile int n;      // readers holding the lock, or -1 for a writer
+  volatile int wwait;  // writers waiting
+  char *name;          // Name of lock.
+};
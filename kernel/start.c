@@ -43,6 +43,12 @@ start()
   w_pmpaddr0(0x3fffffffffffffull);
   w_pmpcfg0(0xf);
 
+  // let supervisor mode read the cycle and time counters,
+  // used by the kernel self-benchmarks.
+  w_mcounteren(r_mcounteren() | 0x3);
+  // and user mode read the time counter, for user benchmarks.
+  w_scounteren(r_scounteren() | 0x2);
+
   // ask for clock interrupts.
   timerinit();
 
@@ -65,7 +71,7 @@ timerinit()
   int id = r_mhartid();
 
   // ask the CLINT for a timer interrupt.
-  int interval = 1000000; // cycles; about 1/10th second in qemu.
+  int interval = TICKINTERVAL;
   *(uint64*)CLINT_MTIMECMP(id) = *(uint64*)CLINT_MTIME + interval;
 
   // prepare information in scratch[] for timervec.
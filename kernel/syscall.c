@@ -6,6 +6,7 @@
 #include "proc.h"
 #include "syscall.h"
 #include "defs.h"
+#include "scstat.h"
 
 // Fetch the uint64 at addr from the current process.
 int
@@ -107,6 +108,18 @@ extern uint64 sys_uptime(void);
 extern uint64 sys_get_cpu(void);
 extern uint64 sys_set_cpu(void);
 extern uint64 sys_cpu_process_count(void);
+extern uint64 sys_kbench(void);
+extern uint64 sys_kmeminfo(void);
+extern uint64 sys_mmap(void);
+extern uint64 sys_munmap(void);
+extern uint64 sys_uring_setup(void);
+extern uint64 sys_uring_enter(void);
+extern uint64 sys_trace(void);
+extern uint64 sys_scstats(void);
+extern uint64 sys_prof(void);
+extern uint64 sys_lockstat(void);
+extern uint64 sys_lockbench(void);
+extern uint64 sys_bcachestat(void);
 
 static uint64 (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -133,8 +146,122 @@ static uint64 (*syscalls[])(void) = {
 [SYS_get_cpu]   sys_get_cpu,
 [SYS_set_cpu]   sys_set_cpu,
 [SYS_cpu_process_count] sys_cpu_process_count,
+[SYS_kbench]   sys_kbench,
+[SYS_kmeminfo] sys_kmeminfo,
+[SYS_mmap]    sys_mmap,
+[SYS_munmap]  sys_munmap,
+[SYS_uring_setup] sys_uring_setup,
+[SYS_uring_enter] sys_uring_enter,
+[SYS_trace]   sys_trace,
+[SYS_scstats] sys_scstats,
+[SYS_prof]    sys_prof,
+[SYS_lockstat] sys_lockstat,
+[SYS_lockbench] sys_lockbench,
+[SYS_bcachestat] sys_bcachestat,
 };
 
+static char *syscallnames[] = {
+[SYS_fork]    "fork",
+[SYS_exit]    "exit",
+[SYS_wait]    "wait",
+[SYS_pipe]    "pipe",
+[SYS_read]    "read",
+[SYS_kill]    "kill",
+[SYS_exec]    "exec",
+[SYS_fstat]   "fstat",
+[SYS_chdir]   "chdir",
+[SYS_dup]     "dup",
+[SYS_getpid]  "getpid",
+[SYS_sbrk]    "sbrk",
+[SYS_sleep]   "sleep",
+[SYS_uptime]  "uptime",
+[SYS_open]    "open",
+[SYS_write]   "write",
+[SYS_mknod]   "mknod",
+[SYS_unlink]  "unlink",
+[SYS_link]    "link",
+[SYS_mkdir]   "mkdir",
+[SYS_close]   "close",
+[SYS_get_cpu]   "get_cpu",
+[SYS_set_cpu]   "set_cpu",
+[SYS_cpu_process_count] "cpu_process_count",
+[SYS_kbench]   "kbench",
+[SYS_kmeminfo] "kmeminfo",
+[SYS_mmap]    "mmap",
+[SYS_munmap]  "munmap",
+[SYS_uring_setup] "uring_setup",
+[SYS_uring_enter] "uring_enter",
+[SYS_trace]   "trace",
+[SYS_scstats] "scstats",
+[SYS_prof]    "prof",
+[SYS_lockstat] "lockstat",
+[SYS_lockbench] "lockbench",
+[SYS_bcachestat] "bcachestat",
+};
+
+// Per-CPU statistics for each system call, so that counting
+// needs no lock; scstats() adds them up.
+static struct scstat stats[NCPU][NELEM(syscalls)];
+
+// Run system call num, whose arguments are in the trapframe,
+// and account for it.
+static uint64
+dispatch(struct proc *p, int num)
+{
+  struct scstat *st;
+  uint64 t0, dt, ret;
+
+  push_off();
+  stats[cpuid()][num].count++;
+  pop_off();
+
+  t0 = r_time();
+  ret = syscalls[num]();
+  dt = r_time() - t0;
+
+  // the call may have slept and woken up on another CPU.
+  push_off();
+  st = &stats[cpuid()][num];
+  st->time += dt;
+  if(dt > st->max)
+    st->max = dt;
+  pop_off();
+
+  if(p->tracemask & (1L << num))
+    printf("%d: syscall %s -> %d\n", p->pid, syscallnames[num], (int)ret);
+  return ret;
+}
+
+// Copy the statistics for system calls 0..n-1, with their
+// names, to user address addr, clearing them if reset is set.
+// Returns the number of system call slots, or -1.
+int
+scstats(uint64 addr, int n, int reset)
+{
+  struct proc *p = myproc();
+  struct scstat st;
+  int num, i;
+
+  if(n > NELEM(syscalls))
+    n = NELEM(syscalls);
+  for(num = 0; num < n; num++){
+    memset(&st, 0, sizeof(st));
+    for(i = 0; i < NCPU; i++){
+      st.count += stats[i][num].count;
+      st.time += stats[i][num].time;
+      if(stats[i][num].max > st.max)
+        st.max = stats[i][num].max;
+    }
+    if(num < NELEM(syscallnames) && syscallnames[num])
+      safestrcpy(st.name, syscallnames[num], sizeof(st.name));
+    if(copyout(p->pagetable, addr + num*sizeof(st), (char*)&st, sizeof(st)) < 0)
+      return -1;
+  }
+  if(reset)
+    memset(stats, 0, sizeof(stats));
+  return NELEM(syscalls);
+}
+
 void
 syscall(void)
 {
@@ -143,10 +270,37 @@ syscall(void)
 
   num = p->trapframe->a7;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
-    p->trapframe->a0 = syscalls[num]();
+    p->trapframe->a0 = dispatch(p, num);
   } else {
     printf("%d %s: unknown sys call %d\n",
             p->pid, p->name, num);
     p->trapframe->a0 = -1;
   }
 }
+
+// Run system call num with arguments args[0..5], for an entry
+// of a uring (see uring.c). Calls that replace or copy the
+// process, or that use the ring themselves, cannot be queued.
+uint64
+syscallring(int num, uint64 *args)
+{
+  struct proc *p = myproc();
+  struct trapframe *tf = p->trapframe;
+  uint64 a0, a1, a2, a3, a4, a5, ret;
+
+  if(num <= 0 || num >= NELEM(syscalls) || syscalls[num] == 0 ||
+     num == SYS_fork || num == SYS_exec || num == SYS_exit ||
+     num == SYS_uring_setup || num == SYS_uring_enter)
+    return -1;
+
+  // argint() and friends read the trapframe, so put the
+  // entry's arguments there for the duration of the call.
+  a0 = tf->a0; a1 = tf->a1; a2 = tf->a2;
+  a3 = tf->a3; a4 = tf->a4; a5 = tf->a5;
+  tf->a0 = args[0]; tf->a1 = args[1]; tf->a2 = args[2];
+  tf->a3 = args[3]; tf->a4 = args[4]; tf->a5 = args[5];
+  ret = dispatch(p, num);
+  tf->a0 = a0; tf->a1 = a1; tf->a2 = a2;
+  tf->a3 = a3; tf->a4 = a4; tf->a5 = a5;
+  return ret;
+}
@@ -23,4 +23,15 @@
 #define SYS_get_cpu 22
 #define SYS_set_cpu 23
 #define SYS_cpu_process_count 24
-
+#define SYS_kbench 25
+#define SYS_kmeminfo 26
+#define SYS_mmap 27
+#define SYS_munmap 28
+#define SYS_uring_setup 29
+#define SYS_uring_enter 30
+#define SYS_trace 31
+#define SYS_scstats 32
+#define SYS_prof 33
+#define SYS_lockstat 34
+#define SYS_lockbench 35
+#define SYS_bcachestat 36
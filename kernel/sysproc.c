@@ -6,6 +6,7 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "kbench.h"
 
 uint64
 sys_exit(void)
@@ -121,4 +122,129 @@ sys_cpu_process_count(void){
   if(argint(0, &cpu_num) < 0)
     return -1;
   return cpu_process_count(cpu_num);
-}
\ No newline at end of file
+}
+
+uint64
+sys_kbench(void)
+{
+  int which;
+
+  if(argint(0, &which) < 0)
+    return -1;
+  return kbench(which);
+}
+
+// contend for a kernel lock of kind kind n times; add a
+// histogram of the waits to the user array addr[0..LOCKBENCH_NHIST-1].
+uint64
+sys_lockbench(void)
+{
+  uint64 hist[LOCKBENCH_NHIST];
+  uint64 addr, dt;
+  int kind, n;
+
+  if(argint(0, &kind) < 0 || argint(1, &n) < 0 || argaddr(2, &addr) < 0)
+    return -1;
+  memset(hist, 0, sizeof(hist));
+  if(lockbench(kind, n, hist, &dt) < 0)
+    return -1;
+  if(copyout(myproc()->pagetable, addr, (char*)hist, sizeof(hist)) < 0)
+    return -1;
+  return dt;
+}
+
+// copy the number of free physical blocks of each
+// order (see kalloc.c) into the user array addr[0..n-1].
+uint64
+sys_kmeminfo(void)
+{
+  int nfree[MAXORDER+1];
+  uint64 addr;
+  int n, norder;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  if(n < 0)
+    return -1;
+  if(n > MAXORDER+1)
+    n = MAXORDER+1;
+  norder = kmeminfo(nfree, n);
+  if(copyout(myproc()->pagetable, addr, (char*)nfree, n*sizeof(int)) < 0)
+    return -1;
+  return norder;
+}
+
+uint64
+sys_uring_setup(void)
+{
+  return uringsetup();
+}
+
+uint64
+sys_uring_enter(void)
+{
+  int n;
+
+  if(argint(0, &n) < 0)
+    return -1;
+  return uringenter(n);
+}
+
+uint64
+sys_trace(void)
+{
+  uint64 mask;
+
+  if(argaddr(0, &mask) < 0)
+    return -1;
+  myproc()->tracemask = mask;
+  return 0;
+}
+
+uint64
+sys_scstats(void)
+{
+  uint64 addr;
+  int n, reset;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0 || argint(2, &reset) < 0)
+    return -1;
+  if(n < 0)
+    return -1;
+  return scstats(addr, n, reset);
+}
+
+uint64
+sys_prof(void)
+{
+  int cmd, n;
+  uint64 addr;
+
+  if(argint(0, &cmd) < 0 || argaddr(1, &addr) < 0 || argint(2, &n) < 0)
+    return -1;
+  return prof(cmd, addr, n);
+}
+
+uint64
+sys_lockstat(void)
+{
+  uint64 addr;
+  int n, reset;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0 || argint(2, &reset) < 0)
+    return -1;
+  if(n < 0)
+    return -1;
+  return lockstat(addr, n, reset);
+}
+
+uint64
+sys_bcachestat(void)
+{
+  uint64 addr;
+  int flags;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &flags) < 0)
+    return -1;
+  return bcachestat(addr, flags);
+}
@@ -15,6 +15,9 @@ extern char trampoline[], uservec[], userret[];
 void kernelvec();
 
 extern int devintr();
+#ifdef UACCESS
+extern char uaccess_start[], uaccess_end[], uaccess_fault[];
+#endif
 
 void
 trapinit(void)
@@ -67,6 +70,9 @@ usertrap(void)
     syscall();
   } else if((which_dev = devintr()) != 0){
     // ok
+  } else if((r_scause() == 13 || r_scause() == 15) &&
+            mmapfault(p->pagetable, r_stval(), r_scause() == 15) == 0){
+    // page of an mmap region
   } else {
     printf("usertrap(): unexpected scause %p pid=%d\n", r_scause(), p->pid);
     printf("            sepc=%p stval=%p\n", r_sepc(), r_stval());
@@ -144,6 +150,15 @@ kerneltrap()
     panic("kerneltrap: interrupts enabled");
 
   if((which_dev = devintr()) == 0){
+#ifdef UACCESS
+    // a bad user address in a direct copy (see udirect()):
+    // make the copy routine return -1.
+    if((scause == 13 || scause == 15) &&
+       sepc >= (uint64)uaccess_start && sepc < (uint64)uaccess_end){
+      w_sepc((uint64)uaccess_fault);
+      return;
+    }
+#endif
     printf("scause %p\n", scause);
     printf("sepc=%p stval=%p\n", r_sepc(), r_stval());
     panic("kerneltrap");
@@ -164,6 +179,7 @@ clockintr()
 {
   acquire(&tickslock);
   ticks++;
+  ushared->ticks = ticks;
   wakeup(&ticks);
   release(&tickslock);
 }
@@ -204,7 +220,9 @@ devintr()
     // software interrupt from a machine-mode timer interrupt,
     // forwarded by timervec in kernelvec.S.
 
-    if(cpuid() == 0){
+    // while profiling, not every timer interrupt is a tick.
+    int tick = proftick();
+    if(tick && cpuid() == 0){
       clockintr();
     }
     
@@ -212,7 +230,7 @@ devintr()
     // the SSIP bit in sip.
     w_sip(r_sip() & ~2);
 
-    return 2;
+    return tick ? 2 : 1;
   } else {
     return 0;
   }
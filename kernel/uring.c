@@ -0,0 +1,87 @@
+//
+// Batched system calls.
+//
+// uring_setup() maps a struct uring page (see uring.h) into the
+// calling process at URING; uring_enter() then runs a batch of
+// the system calls queued there with one trap, dispatching
+// each through syscall.c's table. The ring is not inherited by
+// fork() and is dropped by exec().
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "uring.h"
+
+// Give the current process a ring, if it has none yet.
+// Returns the ring's user address, or -1.
+uint64
+uringsetup(void)
+{
+  struct proc *p = myproc();
+  struct uring *r;
+
+  if(p->uring)
+    return URING;
+  if((r = kzalloc()) == 0)
+    return -1;
+  if(mappages(p->pagetable, URING, PGSIZE, (uint64)r, PTE_R | PTE_W | PTE_U) != 0){
+    kfree(r);
+    return -1;
+  }
+  p->uring = r;
+  return URING;
+}
+
+// Run up to n submitted entries, stopping early if the
+// completion queue fills up or the process is killed.
+// Returns the number of entries run, or -1 if there is no ring.
+int
+uringenter(int n)
+{
+  struct proc *p = myproc();
+  struct uring *r = p->uring;
+  struct uring_sqe sqe;
+  struct uring_cqe *cqe;
+  uint head, tail;
+  int i;
+
+  if(r == 0 || n < 0)
+    return -1;
+
+  // the process may change the ring under us; read each
+  // index once and copy each entry before using it.
+  head = r->sqhead;
+  tail = r->sqtail;
+  __sync_synchronize();
+  if(tail - head > URING_N)
+    return -1;
+
+  for(i = 0; i < n && head != tail && !p->killed; i++, head++){
+    if(r->cqtail - r->cqhead >= URING_N)
+      break;
+    sqe = r->sq[head % URING_N];
+    cqe = &r->cq[r->cqtail % URING_N];
+    cqe->data = sqe.data;
+    cqe->ret = syscallring(sqe.num, sqe.args);
+    __sync_synchronize();
+    r->cqtail++;
+    r->sqhead = head + 1;
+  }
+  return i;
+}
+
+// Unmap and free p's ring, if it has one.
+// Called by exec() and freeproc().
+void
+uringfree(struct proc *p)
+{
+  if(p->uring == 0)
+    return;
+  uvmunmap(p->pagetable, URING, 1, 1);
+  p->uring = 0;
+}
@@ -0,0 +1,30 @@
+// System call submission ring, shared by a process and the
+// kernel at address URING once the process calls uring_setup().
+//
+// The process fills sq[sqtail % URING_N] and advances sqtail;
+// uring_enter() runs entries from sqhead, advancing it, and
+// posts one completion per entry at cq[cqtail % URING_N].
+// The process consumes completions by advancing cqhead.
+
+#define URING_N 32
+
+struct uring_sqe {
+  int num;           // system call number (SYS_*)
+  int pad;
+  uint64 data;       // copied to the completion
+  uint64 args[6];    // arguments, as in a0..a5
+};
+
+struct uring_cqe {
+  uint64 data;       // from the submission
+  uint64 ret;        // what the system call returned
+};
+
+struct uring {
+  uint sqhead;       // written by the kernel
+  uint sqtail;       // written by the process
+  uint cqhead;       // written by the process
+  uint cqtail;       // written by the kernel
+  struct uring_sqe sq[URING_N];
+  struct uring_cqe cq[URING_N];
+};
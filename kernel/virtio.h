@@ -44,8 +44,13 @@
 #define VIRTIO_RING_F_EVENT_IDX     29
 
 // this many virtio descriptors.
-// must be a power of two.
-#define NUM 8
+// must be a power of two, and small enough that the
+// descriptors and the avail ring fit in one page.
+// each request takes two, plus one per block.
+#define NUM 128
+
+// most blocks in one request.
+#define NSEG 32
 
 // a single descriptor, from the spec.
 struct virtq_desc {
@@ -5,6 +5,12 @@
 //
 // qemu ... -drive file=fs.img,if=none,format=raw,id=x0 -device virtio-blk-device,drive=x0,bus=virtio-mmio-bus.0
 //
+// virtio_disk_start() queues requests and returns without
+// waiting, so that a process can keep many requests in flight;
+// virtio_disk_wait() waits for one to finish. A request may
+// cover several consecutive blocks, with a data descriptor
+// for each block's buffer.
+//
 
 #include "types.h"
 #include "riscv.h"
@@ -62,6 +68,7 @@ static struct disk {
   // indexed by first descriptor index of chain.
   struct {
     struct buf *b;
+    void (*done)(struct buf*);
     char status;
   } info[NUM];
 
@@ -184,12 +191,11 @@ free_chain(int i)
   }
 }
 
-// allocate three descriptors (they need not be contiguous).
-// disk transfers always use three descriptors.
+// allocate n descriptors (they need not be contiguous).
 static int
-alloc3_desc(int *idx)
+alloc_descs(int *idx, int n)
 {
-  for(int i = 0; i < 3; i++){
+  for(int i = 0; i < n; i++){
     idx[i] = alloc_desc();
     if(idx[i] < 0){
       for(int j = 0; j < i; j++)
@@ -200,27 +206,27 @@ alloc3_desc(int *idx)
   return 0;
 }
 
-void
-virtio_disk_rw(struct buf *b, int write)
+// Queue one request for the n buffers bs[0..n-1], which
+// hold consecutive blocks. Caller holds disk.vdisk_lock.
+static void
+start_req(struct buf **bs, int n, int write, void (*done)(struct buf*))
 {
-  uint64 sector = b->blockno * (BSIZE / 512);
-
-  acquire(&disk.vdisk_lock);
+  uint64 sector = bs[0]->blockno * (BSIZE / 512);
 
   // the spec's Section 5.2 says that legacy block operations use
-  // three descriptors: one for type/reserved/sector, one for the
-  // data, one for a 1-byte status result.
+  // a descriptor for type/reserved/sector, then descriptors for
+  // the data, then one for a 1-byte status result.
 
-  // allocate the three descriptors.
-  int idx[3];
+  // allocate the descriptors.
+  int idx[NSEG+2];
   while(1){
-    if(alloc3_desc(idx) == 0) {
+    if(alloc_descs(idx, n+2) == 0) {
       break;
     }
     sleep(&disk.free[0], &disk.vdisk_lock);
   }
 
-  // format the three descriptors.
+  // format the descriptors.
   // qemu's virtio-blk.c reads them.
 
   struct virtio_blk_req *buf0 = &disk.ops[idx[0]];
@@ -237,24 +243,30 @@ virtio_disk_rw(struct buf *b, int write)
   disk.desc[idx[0]].flags = VRING_DESC_F_NEXT;
   disk.desc[idx[0]].next = idx[1];
 
-  disk.desc[idx[1]].addr = (uint64) b->data;
-  disk.desc[idx[1]].len = BSIZE;
-  if(write)
-    disk.desc[idx[1]].flags = 0; // device reads b->data
-  else
-    disk.desc[idx[1]].flags = VRING_DESC_F_WRITE; // device writes b->data
-  disk.desc[idx[1]].flags |= VRING_DESC_F_NEXT;
-  disk.desc[idx[1]].next = idx[2];
+  for(int i = 0; i < n; i++){
+    struct virtq_desc *d = &disk.desc[idx[1+i]];
+    d->addr = (uint64) bs[i]->data;
+    d->len = BSIZE;
+    if(write)
+      d->flags = 0; // device reads b->data
+    else
+      d->flags = VRING_DESC_F_WRITE; // device writes b->data
+    d->flags |= VRING_DESC_F_NEXT;
+    d->next = idx[2+i];
+
+    // record struct bufs for virtio_disk_intr().
+    bs[i]->disk = 1;
+    bs[i]->ionext = i+1 < n ? bs[i+1] : 0;
+  }
 
   disk.info[idx[0]].status = 0xff; // device writes 0 on success
-  disk.desc[idx[2]].addr = (uint64) &disk.info[idx[0]].status;
-  disk.desc[idx[2]].len = 1;
-  disk.desc[idx[2]].flags = VRING_DESC_F_WRITE; // device writes the status
-  disk.desc[idx[2]].next = 0;
+  disk.desc[idx[n+1]].addr = (uint64) &disk.info[idx[0]].status;
+  disk.desc[idx[n+1]].len = 1;
+  disk.desc[idx[n+1]].flags = VRING_DESC_F_WRITE; // device writes the status
+  disk.desc[idx[n+1]].next = 0;
 
-  // record struct buf for virtio_disk_intr().
-  b->disk = 1;
-  disk.info[idx[0]].b = b;
+  disk.info[idx[0]].b = bs[0];
+  disk.info[idx[0]].done = done;
 
   // tell the device the first index in our chain of descriptors.
   disk.avail->ring[disk.avail->idx % NUM] = idx[0];
@@ -267,15 +279,39 @@ virtio_disk_rw(struct buf *b, int write)
   __sync_synchronize();
 
   *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
+}
 
-  // Wait for virtio_disk_intr() to say request has finished.
+// Queue a read or write of the n buffers bs[0..n-1]. Runs of
+// buffers holding consecutive blocks go to the device as one
+// request of up to NSEG blocks. Returns once the device has
+// the requests, usually before they have finished. b->disk
+// is 1 until b's request is done; then virtio_disk_intr()
+// clears it, calls done(b) if done is not 0, and wakes up
+// virtio_disk_wait(). done runs in the interrupt handler
+// with the disk lock held, so it must not sleep or start I/O.
+void
+virtio_disk_start(struct buf **bs, int n, int write, void (*done)(struct buf*))
+{
+  int i, run;
+
+  acquire(&disk.vdisk_lock);
+  for(i = 0; i < n; i += run){
+    for(run = 1; i + run < n && run < NSEG; run++)
+      if(bs[i+run]->blockno != bs[i]->blockno + run)
+        break;
+    start_req(bs + i, run, write, done);
+  }
+  release(&disk.vdisk_lock);
+}
+
+// Wait for virtio_disk_intr() to say b's request has finished.
+void
+virtio_disk_wait(struct buf *b)
+{
+  acquire(&disk.vdisk_lock);
   while(b->disk == 1) {
     sleep(b, &disk.vdisk_lock);
   }
-
-  disk.info[idx[0]].b = 0;
-  free_chain(idx[0]);
-
   release(&disk.vdisk_lock);
 }
 
@@ -304,9 +340,17 @@ virtio_disk_intr()
     if(disk.info[id].status != 0)
       panic("virtio_disk_intr status");
 
-    struct buf *b = disk.info[id].b;
-    b->disk = 0;   // disk is done with buf
-    wakeup(b);
+    void (*done)(struct buf*) = disk.info[id].done;
+    struct buf *b, *next;
+    for(b = disk.info[id].b; b; b = next){
+      next = b->ionext;
+      b->disk = 0;   // disk is done with buf
+      if(done)
+        done(b);
+      wakeup(b);
+    }
+    disk.info[id].b = 0;
+    free_chain(id);
 
     disk.used_idx += 1;
   }
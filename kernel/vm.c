@@ -5,6 +5,8 @@
 #include "riscv.h"
 #include "defs.h"
 #include "fs.h"
+#include "spinlock.h"
+#include "proc.h"
 
 /*
  * the kernel's page table.
@@ -21,8 +23,7 @@ kvmmake(void)
 {
   pagetable_t kpgtbl;
 
-  kpgtbl = (pagetable_t) kalloc();
-  memset(kpgtbl, 0, PGSIZE);
+  kpgtbl = (pagetable_t) kzalloc();
 
   // uart registers
   kvmmap(kpgtbl, UART0, UART0, PGSIZE, PTE_R | PTE_W);
@@ -56,6 +57,110 @@ kvminit(void)
   kernel_pagetable = kvmmake();
 }
 
+#ifdef UACCESS
+// Direct user access. Each CPU runs on its own copy of the
+// kernel page table's root, whose first entry points to a
+// per-CPU copy of the kernel's page-table page for the
+// lowest 1 GiB (the devices). While a process runs, the
+// entries of that page below UMIRROR point at the process's
+// own lowest-level page-table pages, so the user memory below
+// UMIRROR shows up in the kernel's address space at the same
+// addresses, with PTE_U set. copyin() and copyout() can then
+// copy to and from user addresses directly, with sstatus.SUM
+// set for the duration of each copy.
+static pagetable_t cpu_root[NCPU];
+static pagetable_t cpu_low[NCPU];
+
+extern int ucopy(void*, const void*, uint64);
+extern int ucopystr(char*, const char*, uint64);
+
+// Switch h/w page table register to this CPU's copy of the
+// kernel's page table, and enable paging.
+void
+kvminithart()
+{
+  int id = cpuid();
+  pagetable_t root, low;
+
+  if((root = kalloc()) == 0 || (low = kalloc()) == 0)
+    panic("kvminithart");
+  memmove(root, kernel_pagetable, PGSIZE);
+  memmove(low, (void*)PTE2PA(kernel_pagetable[0]), PGSIZE);
+  root[0] = PA2PTE(low) | PTE_V;
+  cpu_root[id] = root;
+  cpu_low[id] = low;
+
+  w_satp(MAKE_SATP(root));
+  sfence_vma();
+}
+
+// Make the user memory below UMIRROR in pagetable (0 for none)
+// visible in this CPU's kernel page table. Called when a
+// process is switched in and out, when exec() replaces its
+// page table, and after a direct copy faults, in case the
+// process has since grown new page-table pages.
+void
+uvmmirror(pagetable_t pagetable)
+{
+  pagetable_t low, ulow;
+  int i;
+
+  push_off();
+  low = cpu_low[cpuid()];
+  ulow = 0;
+  if(pagetable && (pagetable[0] & PTE_V))
+    ulow = (pagetable_t)PTE2PA(pagetable[0]);
+  for(i = 0; i < PX(1, UMIRROR); i++)
+    low[i] = ulow ? ulow[i] : 0;
+  sfence_vma();
+  pop_off();
+}
+
+// Copy n bytes from src to dst, one of which is a user address
+// uva in pagetable, directly through the mirror. The copy must
+// not cross a page boundary, so that interrupts are off only
+// briefly; with them off, SUM can't leak into another process's
+// kernel code. Returns 0, or -1 if the caller should fall back
+// to translating uva in software (not the current process,
+// not mirrored, or the copy faulted).
+static int
+udirect(pagetable_t pagetable, void *dst, const void *src, uint64 uva, uint64 n)
+{
+  struct proc *p = myproc();
+  int r;
+
+  if(p == 0 || p->pagetable != pagetable || uva >= UMIRROR || n > UMIRROR - uva)
+    return -1;
+  push_off();
+  w_sstatus(r_sstatus() | SSTATUS_SUM);
+  r = ucopy(dst, src, n);
+  w_sstatus(r_sstatus() & ~SSTATUS_SUM);
+  pop_off();
+  if(r < 0)
+    uvmmirror(pagetable);
+  return r;
+}
+
+// Like udirect(), for copyinstr(): returns 0 if it copied
+// a NUL, 1 if not, -1 to fall back.
+static int
+udirectstr(pagetable_t pagetable, char *dst, uint64 uva, uint64 max)
+{
+  struct proc *p = myproc();
+  int r;
+
+  if(p == 0 || p->pagetable != pagetable || uva >= UMIRROR || max > UMIRROR - uva)
+    return -1;
+  push_off();
+  w_sstatus(r_sstatus() | SSTATUS_SUM);
+  r = ucopystr(dst, (char*)uva, max);
+  w_sstatus(r_sstatus() & ~SSTATUS_SUM);
+  pop_off();
+  if(r < 0)
+    uvmmirror(pagetable);
+  return r;
+}
+#else
 // Switch h/w page table register to the kernel's page table,
 // and enable paging.
 void
@@ -65,6 +170,15 @@ kvminithart()
   sfence_vma();
 }
 
+void
+uvmmirror(pagetable_t pagetable)
+{
+}
+
+#define udirect(pagetable, dst, src, uva, n) (-1)
+#define udirectstr(pagetable, dst, uva, max) (-1)
+#endif
+
 // Return the address of the PTE in page table pagetable
 // that corresponds to virtual address va.  If alloc!=0,
 // create any required page-table pages.
@@ -77,24 +191,36 @@ kvminithart()
 //   21..29 -- 9 bits of level-1 index.
 //   12..20 -- 9 bits of level-0 index.
 //    0..11 -- 12 bits of byte offset within the page.
-pte_t *
-walk(pagetable_t pagetable, uint64 va, int alloc)
+//
+// walklevel() stops descending at the given level, so that
+// mappages() can install a superpage leaf there. If va is
+// already covered by a superpage leaf above that level,
+// that leaf is returned instead.
+static pte_t *
+walklevel(pagetable_t pagetable, uint64 va, int target, int alloc)
 {
   if(va >= MAXVA)
     panic("walk");
 
-  for(int level = 2; level > 0; level--) {
+  for(int level = 2; level > target; level--) {
     pte_t *pte = &pagetable[PX(level, va)];
     if(*pte & PTE_V) {
+      if(PTE_LEAF(*pte))
+        return pte;
       pagetable = (pagetable_t)PTE2PA(*pte);
     } else {
-      if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
+      if(!alloc || (pagetable = (pde_t*)kzalloc()) == 0)
         return 0;
-      memset(pagetable, 0, PGSIZE);
       *pte = PA2PTE(pagetable) | PTE_V;
     }
   }
-  return &pagetable[PX(0, va)];
+  return &pagetable[PX(target, va)];
+}
+
+pte_t *
+walk(pagetable_t pagetable, uint64 va, int alloc)
+{
+  return walklevel(pagetable, va, 0, alloc);
 }
 
 // Look up a virtual address, return the physical address,
@@ -120,6 +246,65 @@ walkaddr(pagetable_t pagetable, uint64 va)
   return pa;
 }
 
+// Like walkaddr(), but for copying to (write) or from the
+// page-aligned user address va. Remembers the current
+// process's last few translations in p->tlb[], so that a copy
+// spanning many pages, or many small copies to the same page
+// (pipes copy a byte at a time), don't walk the page table
+// for every page. Also lets mmapfault() bring in a page of an
+// mmap region, or make it writable.
+static uint64
+uvmaddr(pagetable_t pagetable, uint64 va, int write)
+{
+  struct proc *p = myproc();
+  struct utlb *t;
+  pte_t *pte, need;
+
+  if(va >= MAXVA)
+    return 0;
+
+  need = PTE_V | PTE_U | (write ? PTE_W : 0);
+  if(p && p->pagetable != pagetable)
+    p = 0;
+  if(p){
+    for(t = p->tlb; t < &p->tlb[NUTLB]; t++)
+      if(t->va == va && (t->pte & need) == need)
+        return PTE2PA(t->pte);
+  }
+
+  pte = walk(pagetable, va, 0);
+  if(pte == 0 || (*pte & PTE_V) == 0 || (write && (*pte & PTE_W) == 0)){
+    if(mmapfault(pagetable, va, write) == 0)
+      pte = walk(pagetable, va, 0);
+  }
+  if(pte == 0 || (*pte & need) != need)
+    return 0;
+
+  if(p){
+    t = &p->tlb[p->tlbnext];
+    p->tlbnext = (p->tlbnext + 1) % NUTLB;
+    t->va = va;
+    t->pte = *pte;
+  }
+  return PTE2PA(*pte);
+}
+
+// Forget the translations uvmaddr() has cached for pagetable,
+// after some of its PTEs have changed.
+void
+uvmflush(pagetable_t pagetable)
+{
+  struct proc *p = myproc();
+
+  if(p && p->pagetable == pagetable){
+    memset(p->tlb, 0, sizeof(p->tlb));
+#ifdef UACCESS
+    // the kernel may have the old PTEs cached, too.
+    sfence_vma();
+#endif
+  }
+}
+
 // add a mapping to the kernel page table.
 // only used when booting.
 // does not flush TLB or enable paging.
@@ -130,15 +315,35 @@ kvmmap(pagetable_t kpgtbl, uint64 va, uint64 pa, uint64 sz, int perm)
     panic("kvmmap");
 }
 
+// Return the highest page-table level at which a single leaf
+// can map sz bytes of va to pa: 2 for a 1 GiB gigapage, 1 for
+// a 2 MiB megapage, or 0 for an ordinary 4 KiB page.
+static int
+superlevel(uint64 va, uint64 pa, uint64 sz)
+{
+#ifdef SUPERPAGE
+  for(int level = 2; level > 0; level--){
+    uint64 lsz = LEVELSIZE(level);
+    if((va % lsz) == 0 && (pa % lsz) == 0 && sz >= lsz)
+      return level;
+  }
+#endif
+  return 0;
+}
+
 // Create PTEs for virtual addresses starting at va that refer to
 // physical addresses starting at pa. va and size might not
 // be page-aligned. Returns 0 on success, -1 if walk() couldn't
 // allocate a needed page-table page.
+// Kernel (non-PTE_U) mappings use the largest aligned superpage
+// that fits; user page tables are only ever walked, copied and
+// freed at 4 KiB granularity, so they always get 4 KiB leaves.
 int
 mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
 {
-  uint64 a, last;
+  uint64 a, last, sz;
   pte_t *pte;
+  int level;
 
   if(size == 0)
     panic("mappages: size");
@@ -146,15 +351,19 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
   a = PGROUNDDOWN(va);
   last = PGROUNDDOWN(va + size - 1);
   for(;;){
-    if((pte = walk(pagetable, a, 1)) == 0)
+    level = 0;
+    if((perm & PTE_U) == 0)
+      level = superlevel(a, pa, last + PGSIZE - a);
+    if((pte = walklevel(pagetable, a, level, 1)) == 0)
       return -1;
     if(*pte & PTE_V)
       panic("mappages: remap");
     *pte = PA2PTE(pa) | perm | PTE_V;
-    if(a == last)
+    sz = LEVELSIZE(level);
+    if(last - a < sz)
       break;
-    a += PGSIZE;
-    pa += PGSIZE;
+    a += sz;
+    pa += sz;
   }
   return 0;
 }
@@ -184,6 +393,7 @@ uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
     }
     *pte = 0;
   }
+  uvmflush(pagetable);
 }
 
 // create an empty user page table.
@@ -192,10 +402,9 @@ pagetable_t
 uvmcreate()
 {
   pagetable_t pagetable;
-  pagetable = (pagetable_t) kalloc();
+  pagetable = (pagetable_t) kzalloc();
   if(pagetable == 0)
     return 0;
-  memset(pagetable, 0, PGSIZE);
   return pagetable;
 }
 
@@ -209,8 +418,7 @@ uvminit(pagetable_t pagetable, uchar *src, uint sz)
 
   if(sz >= PGSIZE)
     panic("inituvm: more than a page");
-  mem = kalloc();
-  memset(mem, 0, PGSIZE);
+  mem = kzalloc();
   mappages(pagetable, 0, PGSIZE, (uint64)mem, PTE_W|PTE_R|PTE_X|PTE_U);
   memmove(mem, src, sz);
 }
@@ -228,12 +436,11 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
 
   oldsz = PGROUNDUP(oldsz);
   for(a = oldsz; a < newsz; a += PGSIZE){
-    mem = kalloc();
+    mem = kzalloc();
     if(mem == 0){
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
     if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_W|PTE_X|PTE_R|PTE_U) != 0){
       kfree(mem);
       uvmdealloc(pagetable, a, oldsz);
@@ -329,6 +536,10 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
 
 // mark a PTE invalid for user access.
 // used by exec for the user stack guard page.
+// The kernel may load and store any page without PTE_U,
+// which would let udirect() copy through the guard page,
+// so the page is left execute-only as well: supervisor
+// loads and stores of it fault too.
 void
 uvmclear(pagetable_t pagetable, uint64 va)
 {
@@ -337,7 +548,7 @@ uvmclear(pagetable_t pagetable, uint64 va)
   pte = walk(pagetable, va, 0);
   if(pte == 0)
     panic("uvmclear");
-  *pte &= ~PTE_U;
+  *pte = (*pte & ~(PTE_U | PTE_R | PTE_W)) | PTE_X;
 }
 
 // Copy from kernel to user.
@@ -350,13 +561,15 @@ copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
 
   while(len > 0){
     va0 = PGROUNDDOWN(dstva);
-    pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0)
-      return -1;
     n = PGSIZE - (dstva - va0);
     if(n > len)
       n = len;
-    memmove((void *)(pa0 + (dstva - va0)), src, n);
+    if(udirect(pagetable, (void *)dstva, src, dstva, n) < 0){
+      pa0 = uvmaddr(pagetable, va0, 1);
+      if(pa0 == 0)
+        return -1;
+      memmove((void *)(pa0 + (dstva - va0)), src, n);
+    }
 
     len -= n;
     src += n;
@@ -375,13 +588,15 @@ copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 
   while(len > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0)
-      return -1;
     n = PGSIZE - (srcva - va0);
     if(n > len)
       n = len;
-    memmove(dst, (void *)(pa0 + (srcva - va0)), n);
+    if(udirect(pagetable, dst, (void *)srcva, srcva, n) < 0){
+      pa0 = uvmaddr(pagetable, va0, 0);
+      if(pa0 == 0)
+        return -1;
+      memmove(dst, (void *)(pa0 + (srcva - va0)), n);
+    }
 
     len -= n;
     dst += n;
@@ -398,17 +613,26 @@ int
 copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
 {
   uint64 n, va0, pa0;
-  int got_null = 0;
+  int got_null = 0, r;
 
   while(got_null == 0 && max > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0)
-      return -1;
     n = PGSIZE - (srcva - va0);
     if(n > max)
       n = max;
 
+    if((r = udirectstr(pagetable, dst, srcva, n)) >= 0){
+      got_null = (r == 0);
+      dst += n;
+      max -= n;
+      srcva = va0 + PGSIZE;
+      continue;
+    }
+
+    pa0 = uvmaddr(pagetable, va0, 0);
+    if(pa0 == 0)
+      return -1;
+
     char *p = (char *) (pa0 + (srcva - va0));
     while(n > 0){
       if(*p == '\0'){
@@ -22,7 +22,9 @@
 
 int nbitmap = FSSIZE/(BSIZE*8) + 1;
 int ninodeblocks = NINODES / IPB + 1;
-int nlog = LOGSIZE;
+int nlogblocks = 60;  // data blocks in each half of the log (-l)
+int maxop = 30;       // most log blocks one FS operation may write (-o)
+int nlog;     // Number of log blocks: two halves, each a header and nlogblocks
 int nmeta;    // Number of meta blocks (boot, sb, nlog, inode, bitmap)
 int nblocks;  // Number of data blocks
 
@@ -40,6 +42,7 @@ void rinode(uint inum, struct dinode *ip);
 void rsect(uint sec, void *buf);
 uint ialloc(ushort type);
 void iappend(uint inum, void *p, int n);
+uint fmap(struct dinode *din, uint fbn);
 void die(const char *);
 
 // convert to intel byte order
@@ -77,10 +80,26 @@ main(int argc, char *argv[])
 
   static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
 
-  if(argc < 2){
-    fprintf(stderr, "Usage: mkfs fs.img files...\n");
+  while(argc > 2 && argv[1][0] == '-'){
+    if(strcmp(argv[1], "-l") == 0)
+      nlogblocks = atoi(argv[2]);
+    else if(strcmp(argv[1], "-o") == 0)
+      maxop = atoi(argv[2]);
+    else
+      break;
+    argc -= 2;
+    argv += 2;
+  }
+  if(argc < 2 || argv[1][0] == '-'){
+    fprintf(stderr, "Usage: mkfs [-l logblocks] [-o opblocks] fs.img files...\n");
     exit(1);
   }
+  if(nlogblocks > LOGSIZE || maxop < MAXOPBLOCKS || maxop > nlogblocks){
+    fprintf(stderr, "mkfs: need %d <= opblocks <= logblocks <= %d\n",
+            MAXOPBLOCKS, LOGSIZE);
+    exit(1);
+  }
+  nlog = 2*(nlogblocks+1);
 
   assert((BSIZE % sizeof(struct dinode)) == 0);
   assert((BSIZE % sizeof(struct dirent)) == 0);
@@ -101,9 +120,11 @@ main(int argc, char *argv[])
   sb.logstart = xint(2);
   sb.inodestart = xint(2+nlog);
   sb.bmapstart = xint(2+nlog+ninodeblocks);
+  sb.maxop = xint(maxop);
 
   printf("nmeta %d (boot, super, log blocks %u inode blocks %u, bitmap blocks %u) blocks %d total %d\n",
          nmeta, nlog, ninodeblocks, nbitmap, nblocks, FSSIZE);
+  printf("log: 2 halves of %d blocks, %d blocks per operation\n", nlogblocks, maxop);
 
   freeblock = nmeta;     // the first free block that we can allocate
 
@@ -128,10 +149,12 @@ main(int argc, char *argv[])
   iappend(rootino, &de, sizeof(de));
 
   for(i = 2; i < argc; i++){
-    // get rid of "user/"
+    // get rid of "user/" or "kernel/"
     char *shortname;
     if(strncmp(argv[i], "user/", 5) == 0)
       shortname = argv[i] + 5;
+    else if(strncmp(argv[i], "kernel/", 7) == 0)
+      shortname = argv[i] + 7;
     else
       shortname = argv[i];
     
@@ -235,20 +258,66 @@ void
 balloc(int used)
 {
   uchar buf[BSIZE];
-  int i;
+  int i, b;
 
   printf("balloc: first %d blocks have been allocated\n", used);
-  assert(used < BSIZE*8);
-  bzero(buf, BSIZE);
-  for(i = 0; i < used; i++){
-    buf[i/8] = buf[i/8] | (0x1 << (i%8));
+  assert(used <= nbitmap*BPB);
+  for(b = 0; b < nbitmap; b++){
+    bzero(buf, BSIZE);
+    for(i = 0; i < BPB && b*BPB + i < used; i++){
+      buf[i/8] = buf[i/8] | (0x1 << (i%8));
+    }
+    printf("balloc: write bitmap block at sector %d\n", sb.bmapstart + b);
+    wsect(sb.bmapstart + b, buf);
   }
-  printf("balloc: write bitmap block at sector %d\n", sb.bmapstart);
-  wsect(sb.bmapstart, buf);
 }
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
+// Return the block holding block fbn of din. If fbn is just
+// past the end of the file, allocate it the way the kernel's
+// bmap() does: at the end of the last extent if that is
+// where the next free block is, else in a new extent, else
+// through the doubly-indirect block.
+uint
+fmap(struct dinode *din, uint fbn)
+{
+  uint x, indirect[NINDIRECT];
+  int i, j;
+
+  for(i = 0; i < NEXTENT && xint(din->ext[i].len) > 0; i++){
+    if(fbn < xint(din->ext[i].len))
+      return xint(din->ext[i].start) + fbn;
+    fbn -= xint(din->ext[i].len);
+  }
+  if(din->dindirect == 0){
+    assert(fbn == 0);
+    if(i > 0 && xint(din->ext[i-1].start) + xint(din->ext[i-1].len) == freeblock){
+      din->ext[i-1].len = xint(xint(din->ext[i-1].len) + 1);
+      return freeblock++;
+    }
+    if(i < NEXTENT){
+      din->ext[i].start = xint(freeblock);
+      din->ext[i].len = xint(1);
+      return freeblock++;
+    }
+    din->dindirect = xint(freeblock++);
+  }
+
+  assert(fbn < NINDIRECT*NINDIRECT);
+  x = xint(din->dindirect);
+  for(i = 0; i < 2; i++){
+    rsect(x, (char*)indirect);
+    j = i == 0 ? fbn / NINDIRECT : fbn % NINDIRECT;
+    if(indirect[j] == 0){
+      indirect[j] = xint(freeblock++);
+      wsect(x, (char*)indirect);
+    }
+    x = xint(indirect[j]);
+  }
+  return x;
+}
+
 void
 iappend(uint inum, void *xp, int n)
 {
@@ -256,7 +325,6 @@ iappend(uint inum, void *xp, int n)
   uint fbn, off, n1;
   struct dinode din;
   char buf[BSIZE];
-  uint indirect[NINDIRECT];
   uint x;
 
   rinode(inum, &din);
@@ -265,22 +333,7 @@ iappend(uint inum, void *xp, int n)
   while(n > 0){
     fbn = off / BSIZE;
     assert(fbn < MAXFILE);
-    if(fbn < NDIRECT){
-      if(xint(din.addrs[fbn]) == 0){
-        din.addrs[fbn] = xint(freeblock++);
-      }
-      x = xint(din.addrs[fbn]);
-    } else {
-      if(xint(din.addrs[NDIRECT]) == 0){
-        din.addrs[NDIRECT] = xint(freeblock++);
-      }
-      rsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-      if(indirect[fbn - NDIRECT] == 0){
-        indirect[fbn - NDIRECT] = xint(freeblock++);
-        wsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-      }
-      x = xint(indirect[fbn-NDIRECT]);
-    }
+    x = fmap(&din, fbn);
     n1 = min(n, (fbn + 1) * BSIZE - off);
     rsect(x, buf);
     bcopy(p, buf + off - (fbn * BSIZE), n1);
@@ -0,0 +1,135 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+#include "kernel/lockstat.h"
+#include "kernel/bcachestat.h"
+#include "kernel/memlayout.h"
+#include "user/user.h"
+
+// measure the buffer cache under parallel reads: one process
+// per CPU reads its own small file over and over, so every
+// read() is a cache hit and the time goes to looking blocks
+// up. Reports the total throughput and the contention on the
+// buffer cache locks and its hit rate while the readers ran.
+//
+//   bcachebench [nproc [count]]
+
+#define MAXPROC 16
+#define NBLOCK 4
+#define NCLASS 64
+
+char buf[NBLOCK*BSIZE];
+struct lockstat st[NCLASS];
+struct bcachestat bst;
+
+void
+mkname(char *name, int i)
+{
+  strcpy(name, "bcachebench.0");
+  name[strlen(name)-1] = 'a' + i;
+}
+
+void
+reader(int i, int count)
+{
+  char name[32];
+  int fd, j;
+
+  mkname(name, i);
+  for(j = 0; j < count; j++){
+    if((fd = open(name, O_RDONLY)) < 0){
+      fprintf(2, "bcachebench: open %s failed\n", name);
+      exit(1);
+    }
+    if(read(fd, buf, sizeof(buf)) != sizeof(buf)){
+      fprintf(2, "bcachebench: read failed\n");
+      exit(1);
+    }
+    close(fd);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nproc = NCPU, count = 2000;
+  int go[2], res[2], i, n, fd, pid;
+  uint64 t0, dt, maxdt;
+  char name[32], c;
+
+  if(argc > 1)
+    nproc = atoi(argv[1]);
+  if(argc > 2)
+    count = atoi(argv[2]);
+  if(nproc < 1 || nproc > MAXPROC || count < 1){
+    fprintf(2, "usage: bcachebench [nproc [count]]\n");
+    exit(1);
+  }
+
+  memset(buf, 'x', sizeof(buf));
+  for(i = 0; i < nproc; i++){
+    mkname(name, i);
+    if((fd = open(name, O_CREATE|O_RDWR|O_TRUNC)) < 0 ||
+       write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      fprintf(2, "bcachebench: create %s failed\n", name);
+      exit(1);
+    }
+    close(fd);
+  }
+
+  if(pipe(go) < 0 || pipe(res) < 0){
+    fprintf(2, "bcachebench: pipe failed\n");
+    exit(1);
+  }
+  for(i = 0; i < nproc; i++){
+    pid = fork();
+    if(pid < 0){
+      fprintf(2, "bcachebench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      set_cpu(i % NCPU);
+      read(go[0], &c, 1);
+      t0 = rdtime();
+      reader(i, count);
+      dt = rdtime() - t0;
+      write(res[1], &dt, sizeof(dt));
+      exit(0);
+    }
+  }
+  // start them all at once.
+  lockstat(st, NCLASS, 1);
+  bcachestat(&bst, BCACHE_RESET);
+  for(i = 0; i < nproc; i++)
+    write(go[1], "x", 1);
+
+  maxdt = 1;
+  for(i = 0; i < nproc; i++){
+    if(read(res[0], &dt, sizeof(dt)) != sizeof(dt)){
+      fprintf(2, "bcachebench: short result\n");
+      exit(1);
+    }
+    if(dt > maxdt)
+      maxdt = dt;
+  }
+  for(i = 0; i < nproc; i++)
+    wait(0);
+  n = lockstat(st, NCLASS, 0);
+  bcachestat(&bst, 0);
+
+  printf("bcachebench: %d processes, %d blocks/ms\n", nproc,
+         (int)((uint64)nproc * count * NBLOCK * (TIMEFREQ / 1000) / maxdt));
+  for(i = 0; i < n && i < NCLASS; i++)
+    if(strcmp(st[i].name, "bcache") == 0 || strcmp(st[i].name, "bcache.bucket") == 0)
+      printf("%s: %d acquires, %d contended, %d spin-kcycles\n", st[i].name,
+             (int)st[i].nacquire, (int)st[i].ncontend, (int)(st[i].spin / 1000));
+  printf("%d hits, %d misses, %d buffers of at most %d\n", (int)bst.hits,
+         (int)bst.misses, bst.nbuf, bst.maxbuf);
+
+  for(i = 0; i < nproc; i++){
+    mkname(name, i);
+    unlink(name);
+  }
+  exit(0);
+}
@@ -0,0 +1,107 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/memlayout.h"
+#include "user/user.h"
+
+// measure how fast read() and write() move data between
+// user memory and the kernel: through a pipe, which copies
+// a byte at a time, and from a file small enough to stay in
+// the buffer cache, which copies a block at a time.
+
+#define TOTAL (2*1024*1024)
+#define FILESZ (16*1024)
+
+char buf[FILESZ];
+
+void
+report(char *what, int chunk, uint64 dt)
+{
+  int us = dt / (TIMEFREQ / 1000000);
+
+  if(us == 0)
+    us = 1;
+  printf("%s %d: %d KiB in %d us, %d KiB/s\n",
+         what, chunk, TOTAL / 1024, us,
+         (int)((uint64)TOTAL / 1024 * 1000000 / us));
+}
+
+void
+pipebench(int chunk)
+{
+  int fds[2], pid, n, i;
+  uint64 t0;
+
+  if(pipe(fds) < 0){
+    fprintf(2, "copybench: pipe failed\n");
+    exit(1);
+  }
+  t0 = rdtime();
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "copybench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(fds[1]);
+    while((n = read(fds[0], buf, chunk)) > 0)
+      ;
+    exit(0);
+  }
+  close(fds[0]);
+  for(i = 0; i < TOTAL; i += chunk){
+    if(write(fds[1], buf, chunk) != chunk){
+      fprintf(2, "copybench: pipe write failed\n");
+      exit(1);
+    }
+  }
+  close(fds[1]);
+  wait(0);
+  report("pipe", chunk, rdtime() - t0);
+}
+
+void
+filebench(int chunk)
+{
+  int fd, i, j;
+  uint64 t0;
+
+  t0 = rdtime();
+  for(i = 0; i < TOTAL; i += FILESZ){
+    if((fd = open("copybench.tmp", O_RDONLY)) < 0){
+      fprintf(2, "copybench: open failed\n");
+      exit(1);
+    }
+    for(j = 0; j < FILESZ; j += chunk){
+      if(read(fd, buf + j, chunk) != chunk){
+        fprintf(2, "copybench: read failed\n");
+        exit(1);
+      }
+    }
+    close(fd);
+  }
+  report("file read", chunk, rdtime() - t0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fd;
+
+  memset(buf, 'x', sizeof(buf));
+  if((fd = open("copybench.tmp", O_CREATE|O_WRONLY)) < 0 ||
+     write(fd, buf, FILESZ) != FILESZ){
+    fprintf(2, "copybench: cannot create copybench.tmp\n");
+    exit(1);
+  }
+  close(fd);
+
+  pipebench(512);
+  pipebench(4096);
+  filebench(1024);
+  filebench(4096);
+  filebench(FILESZ);
+
+  unlink("copybench.tmp");
+  exit(0);
+}
@@ -2,34 +2,55 @@
 
 #include "kernel/types.h"
 #include "kernel/stat.h"
+#include "kernel/fcntl.h"
 #include "user/user.h"
 
 char buf[1024];
 int match(char*, char*);
 
+// Print the complete lines in p[0..n-1] that match pattern.
+// Modifies p. Returns the number of bytes consumed.
+int
+grepbuf(char *pattern, char *p, int n)
+{
+  char *q, *start;
+
+  start = p;
+  for(q = p; q < start + n; q++){
+    if(*q != '\n')
+      continue;
+    *q = 0;
+    if(match(pattern, p)){
+      *q = '\n';
+      write(1, p, q+1 - p);
+    }
+    p = q+1;
+  }
+  return p - start;
+}
+
 void
 grep(char *pattern, int fd)
 {
-  int n, m;
-  char *p, *q;
+  int n, m, k;
+  struct stat st;
+  char *p;
+
+  // scan regular files in place; a private mapping
+  // lets grepbuf() write into it.
+  if(fstat(fd, &st) == 0 && st.type == T_FILE && st.size > 0 &&
+     (p = mmap(0, st.size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0)) != (char*)-1){
+    grepbuf(pattern, p, st.size);
+    munmap(p, st.size);
+    return;
+  }
 
   m = 0;
   while((n = read(fd, buf+m, sizeof(buf)-m-1)) > 0){
     m += n;
-    buf[m] = '\0';
-    p = buf;
-    while((q = strchr(p, '\n')) != 0){
-      *q = 0;
-      if(match(pattern, p)){
-        *q = '\n';
-        write(1, p, q+1 - p);
-      }
-      p = q+1;
-    }
-    if(m > 0){
-      m -= p - buf;
-      memmove(buf, p, m);
-    }
+    k = grepbuf(pattern, buf, m);
+    m -= k;
+    memmove(buf, buf+k, m);
   }
 }
 
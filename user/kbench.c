@@ -0,0 +1,44 @@
+#include "kernel/types.h"
+#include "kernel/kbench.h"
+#include "user/user.h"
+
+// run kernel self-benchmarks; the kernel prints the results.
+
+struct {
+  char *name;
+  int which;
+} benches[] = {
+  { "memmove", KBENCH_MEMMOVE },
+  { "memset",  KBENCH_MEMSET },
+  { "memcmp",  KBENCH_MEMCMP },
+};
+
+#define NBENCH (sizeof(benches) / sizeof(benches[0]))
+
+int
+main(int argc, char *argv[])
+{
+  int i, j;
+
+  if(argc < 2){
+    for(j = 0; j < NBENCH; j++)
+      if(kbench(benches[j].which) < 0)
+        fprintf(2, "kbench: %s failed\n", benches[j].name);
+    exit(0);
+  }
+
+  for(i = 1; i < argc; i++){
+    for(j = 0; j < NBENCH; j++)
+      if(strcmp(argv[i], benches[j].name) == 0)
+        break;
+    if(j == NBENCH){
+      fprintf(2, "usage: kbench [memmove|memset|memcmp]...\n");
+      exit(1);
+    }
+    if(kbench(benches[j].which) < 0){
+      fprintf(2, "kbench: %s failed\n", argv[i]);
+      exit(1);
+    }
+  }
+  exit(0);
+}
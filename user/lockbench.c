@@ -0,0 +1,130 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/spinlock.h"
+#include "kernel/kbench.h"
+#include "kernel/memlayout.h"
+#include "user/user.h"
+
+// compare the kernel's spinlock kinds under contention: one
+// process per CPU takes and releases the same kernel lock as
+// fast as it can, and we report the total throughput and the
+// median, 99th percentile and worst wait for the lock.
+//
+//   lockbench [nproc [count]]
+
+struct {
+  char *name;
+  int kind;
+} kinds[] = {
+  { "tas",    LOCK_TAS },
+  { "ticket", LOCK_TICKET },
+  { "mcs",    LOCK_MCS },
+};
+
+#define NKIND (sizeof(kinds) / sizeof(kinds[0]))
+#define MAXPROC 16
+
+struct result {
+  uint64 dt;
+  uint64 hist[LOCKBENCH_NHIST];
+};
+
+// smallest bucket bound that covers fraction num/den of the waits.
+uint64
+percentile(uint64 *hist, uint64 total, int num, int den)
+{
+  uint64 sum = 0;
+  int b;
+
+  for(b = 0; b < LOCKBENCH_NHIST; b++){
+    sum += hist[b];
+    if(sum * den >= total * num)
+      break;
+  }
+  return 2L << b;
+}
+
+void
+run(char *name, int kind, int nproc, int count)
+{
+  struct result r, all;
+  int go[2], res[2], i, b, pid;
+  uint64 total, dt;
+  char c;
+
+  if(pipe(go) < 0 || pipe(res) < 0){
+    fprintf(2, "lockbench: pipe failed\n");
+    exit(1);
+  }
+  for(i = 0; i < nproc; i++){
+    pid = fork();
+    if(pid < 0){
+      fprintf(2, "lockbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      set_cpu(i % NCPU);
+      read(go[0], &c, 1);
+      memset(&r, 0, sizeof(r));
+      int t = lockbench(kind, count, r.hist);
+      if(t < 0){
+        fprintf(2, "lockbench: lockbench failed\n");
+        exit(1);
+      }
+      r.dt = t;
+      write(res[1], &r, sizeof(r));
+      exit(0);
+    }
+  }
+  // start them all at once.
+  for(i = 0; i < nproc; i++)
+    write(go[1], "x", 1);
+
+  memset(&all, 0, sizeof(all));
+  for(i = 0; i < nproc; i++){
+    if(read(res[0], &r, sizeof(r)) != sizeof(r)){
+      fprintf(2, "lockbench: short result\n");
+      exit(1);
+    }
+    if(r.dt > all.dt)
+      all.dt = r.dt;
+    for(b = 0; b < LOCKBENCH_NHIST; b++)
+      all.hist[b] += r.hist[b];
+  }
+  for(i = 0; i < nproc; i++)
+    wait(0);
+  close(go[0]);
+  close(go[1]);
+  close(res[0]);
+  close(res[1]);
+
+  total = (uint64)nproc * count;
+  dt = all.dt ? all.dt : 1;
+  for(b = LOCKBENCH_NHIST-1; b > 0 && all.hist[b] == 0; b--)
+    ;
+  printf("%s: %d acquires/ms, wait cycles p50 <%d p99 <%d max <%d\n", name,
+         (int)(total * (TIMEFREQ / 1000) / dt),
+         (int)percentile(all.hist, total, 50, 100),
+         (int)percentile(all.hist, total, 99, 100),
+         (int)(2L << b));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nproc = NCPU, count = 100000;
+  int k;
+
+  if(argc > 1)
+    nproc = atoi(argv[1]);
+  if(argc > 2)
+    count = atoi(argv[2]);
+  if(nproc < 1 || nproc > MAXPROC || count < 1){
+    fprintf(2, "usage: lockbench [nproc [count]]\n");
+    exit(1);
+  }
+  printf("lockbench: %d processes, %d acquires each\n", nproc, count);
+  for(k = 0; k < NKIND; k++)
+    run(kinds[k].name, kinds[k].kind, nproc, count);
+  exit(0);
+}
@@ -0,0 +1,69 @@
+#include "kernel/types.h"
+#include "kernel/lockstat.h"
+#include "user/user.h"
+
+// list the most contended kernel spinlocks, by name.
+//
+//   lockstat          counts since boot (or the last reset)
+//   lockstat cmd      clear the counts, run cmd, and report
+//                     the contention while it ran
+
+#define NCLASS 64
+#define NSHOW 16
+
+struct lockstat st[NCLASS];
+
+void
+report(int n)
+{
+  int i, best, shown;
+
+  printf("%s %s %s %s\n", "lock", "acquires", "contended", "spin-kcycles");
+  for(shown = 0; shown < NSHOW; shown++){
+    best = -1;
+    for(i = 0; i < n; i++)
+      if(st[i].ncontend && (best < 0 || st[i].spin > st[best].spin))
+        best = i;
+    if(best < 0)
+      break;
+    printf("%s %d %d %d\n", st[best].name, (int)st[best].nacquire,
+           (int)st[best].ncontend, (int)(st[best].spin / 1000));
+    st[best].ncontend = 0;
+  }
+  if(shown == 0)
+    printf("no contention\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n, pid;
+
+  if(argc < 2){
+    if((n = lockstat(st, NCLASS, 0)) < 0){
+      fprintf(2, "lockstat: lockstat failed\n");
+      exit(1);
+    }
+    report(n < NCLASS ? n : NCLASS);
+    exit(0);
+  }
+
+  lockstat(st, NCLASS, 1);
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "lockstat: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    fprintf(2, "lockstat: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+  if((n = lockstat(st, NCLASS, 0)) < 0){
+    fprintf(2, "lockstat: lockstat failed\n");
+    exit(1);
+  }
+  report(n < NCLASS ? n : NCLASS);
+  exit(0);
+}
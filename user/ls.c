@@ -2,6 +2,20 @@
 #include "kernel/stat.h"
 #include "user/user.h"
 #include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "kernel/syscall.h"
+#include "kernel/uring.h"
+
+// Directory entries are stat()ed NBATCH at a time through a
+// uring: one uring_enter() opens them all, a second fstat()s
+// and closes them, instead of three system calls per entry.
+#define NBATCH 8
+
+struct uring *ring;
+char bpath[NBATCH][512];
+struct stat bst[NBATCH];
+int bfd[NBATCH];
+int nbatch;
 
 char*
 fmtname(char *path)
@@ -22,6 +36,68 @@ fmtname(char *path)
   return buf;
 }
 
+// Stat and print the entries in bpath[]. Whatever the ring
+// does not get to (if uring_enter() runs fewer entries than
+// were queued) is dropped from it and done with plain
+// system calls instead.
+void
+flush(void)
+{
+  uint64 d, ret;
+  int i, n;
+  int sret[NBATCH];
+  char closed[NBATCH];
+
+  for(i = 0; i < nbatch; i++){
+    bfd[i] = -1;
+    sret[i] = -1;
+    closed[i] = 0;
+  }
+  if(ring){
+    for(i = 0; i < nbatch; i++)
+      uring_queue(ring, SYS_open, i, (uint64)bpath[i], O_RDONLY, 0);
+    if(uring_enter(nbatch) < nbatch)
+      ring->sqtail = ring->sqhead;
+    while(uring_reap(ring, &d, &ret) == 0)
+      bfd[d] = ret;
+    n = 0;
+    for(i = 0; i < nbatch; i++){
+      if(bfd[i] < 0)
+        continue;
+      uring_queue(ring, SYS_fstat, i, bfd[i], (uint64)&bst[i], 0);
+      uring_queue(ring, SYS_close, NBATCH + i, bfd[i], 0, 0);
+      n += 2;
+    }
+    if(uring_enter(n) < n)
+      ring->sqtail = ring->sqhead;
+    while(uring_reap(ring, &d, &ret) == 0){
+      if(d < NBATCH)
+        sret[d] = ret;
+      else
+        closed[d - NBATCH] = 1;
+    }
+  }
+
+  for(i = 0; i < nbatch; i++){
+    if(bfd[i] < 0){
+      sret[i] = stat(bpath[i], &bst[i]);
+    } else if(!closed[i]){
+      if(sret[i] < 0)
+        sret[i] = fstat(bfd[i], &bst[i]);
+      close(bfd[i]);
+    }
+  }
+
+  for(i = 0; i < nbatch; i++){
+    if(sret[i] < 0){
+      printf("ls: cannot stat %s\n", bpath[i]);
+      continue;
+    }
+    printf("%s %d %d %d\n", fmtname(bpath[i]), bst[i].type, bst[i].ino, bst[i].size);
+  }
+  nbatch = 0;
+}
+
 void
 ls(char *path)
 {
@@ -59,12 +135,11 @@ ls(char *path)
         continue;
       memmove(p, de.name, DIRSIZ);
       p[DIRSIZ] = 0;
-      if(stat(buf, &st) < 0){
-        printf("ls: cannot stat %s\n", buf);
-        continue;
-      }
-      printf("%s %d %d %d\n", fmtname(buf), st.type, st.ino, st.size);
+      strcpy(bpath[nbatch++], buf);
+      if(nbatch == NBATCH)
+        flush();
     }
+    flush();
     break;
   }
   close(fd);
@@ -75,6 +150,8 @@ main(int argc, char *argv[])
 {
   int i;
 
+  if((ring = uring_setup()) == (struct uring*)-1)
+    ring = 0;
   if(argc < 2){
     ls(".");
     exit(0);
@@ -0,0 +1,198 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/prof.h"
+#include "user/user.h"
+
+// profile a command: sample where each CPU is on every timer
+// interrupt while the command runs, then print the functions
+// the samples fall in, most samples first.
+//
+//   prof [-n count] cmd [args...]
+//
+// kernel samples are looked up in kernel.sym, user samples in
+// cmd.sym (the build puts both on the file system).
+
+#define NSAMPLE (NCPU*1024)
+
+struct profsample samples[NSAMPLE];
+
+struct sym {
+  uint64 addr;
+  char *name;
+  int count;
+};
+
+struct symtab {
+  struct sym *syms;
+  int n;
+  int other;          // samples that matched no symbol
+};
+
+struct symtab ktab, utab;
+
+uint64
+hex(char *s, char **end)
+{
+  uint64 x = 0;
+  int c;
+
+  for(;; s++){
+    c = *s;
+    if(c >= '0' && c <= '9')
+      x = x*16 + c - '0';
+    else if(c >= 'a' && c <= 'f')
+      x = x*16 + c - 'a' + 10;
+    else
+      break;
+  }
+  *end = s;
+  return x;
+}
+
+// read a symbol file written by the Makefile, one
+// "address name" per line, keeping function-like names.
+void
+loadsyms(char *path, struct symtab *t)
+{
+  struct stat st;
+  char *buf, *p, *e;
+  int fd, n, max;
+
+  t->n = 0;
+  if((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) < 0){
+    fprintf(2, "prof: cannot read %s\n", path);
+    return;
+  }
+  buf = malloc(st.size + 1);
+  if((n = read(fd, buf, st.size)) < 0)
+    n = 0;
+  buf[n] = 0;
+  close(fd);
+
+  max = 1;
+  for(p = buf; *p; p++)
+    if(*p == '\n')
+      max++;
+  t->syms = malloc(max * sizeof(struct sym));
+
+  for(p = buf; *p; p = e){
+    uint64 addr = hex(p, &e);
+    if(*e == ' ')
+      e++;
+    char *name = e;
+    while(*e && *e != '\n')
+      e++;
+    if(*e)
+      *e++ = 0;
+    // skip section, file and local label names.
+    if(name[0] == 0 || name[0] == '.' || strchr(name, '.'))
+      continue;
+    t->syms[t->n].addr = addr;
+    t->syms[t->n].name = name;
+    t->syms[t->n].count = 0;
+    t->n++;
+  }
+}
+
+// charge a sample to the symbol with the highest address <= pc.
+void
+charge(struct symtab *t, uint64 pc)
+{
+  struct sym *best = 0;
+
+  for(int i = 0; i < t->n; i++)
+    if(t->syms[i].addr <= pc && (best == 0 || t->syms[i].addr > best->addr))
+      best = &t->syms[i];
+  if(best)
+    best->count++;
+  else
+    t->other++;
+}
+
+// print up to max symbols by descending sample count.
+void
+report(char *what, struct symtab *t, int total, int max)
+{
+  struct sym *best;
+  int i;
+
+  while(max-- > 0){
+    best = 0;
+    for(i = 0; i < t->n; i++)
+      if(t->syms[i].count && (best == 0 || t->syms[i].count > best->count))
+        best = &t->syms[i];
+    if(best == 0)
+      break;
+    printf("%d%% %d %s %s\n", best->count * 100 / total, best->count, what, best->name);
+    best->count = 0;
+  }
+  if(t->other)
+    printf("%d%% %d %s ?\n", t->other * 100 / total, t->other, what);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char path[MAXPATH];
+  int i, n, pid, max = 20;
+
+  if(argc > 2 && strcmp(argv[1], "-n") == 0){
+    max = atoi(argv[2]);
+    argv += 2;
+    argc -= 2;
+  }
+  if(argc < 2){
+    fprintf(2, "usage: prof [-n count] cmd [args...]\n");
+    exit(1);
+  }
+
+  if(prof(PROF_START, 0, 0) < 0){
+    fprintf(2, "prof: cannot start profiling\n");
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "prof: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    fprintf(2, "prof: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+  prof(PROF_STOP, 0, 0);
+  if((n = prof(PROF_READ, samples, NSAMPLE)) <= 0){
+    fprintf(2, "prof: no samples\n");
+    exit(1);
+  }
+
+  loadsyms("kernel.sym", &ktab);
+  if(strlen(argv[1]) + 5 < sizeof(path)){
+    strcpy(path, argv[1]);
+    strcpy(path + strlen(path), ".sym");
+    loadsyms(path, &utab);
+  }
+
+  // user pcs of other processes (on other CPUs) mean
+  // nothing in cmd's symbol table; only count them.
+  int idle = 0, elsewhere = 0;
+  for(i = 0; i < n; i++){
+    if(samples[i].pid == 0)
+      idle++;
+    else if(samples[i].user && samples[i].pid != pid)
+      elsewhere++;
+    else if(samples[i].user)
+      charge(&utab, samples[i].pc);
+    else
+      charge(&ktab, samples[i].pc);
+  }
+
+  printf("%d samples, %d idle, %d in other processes' user code\n",
+         n, idle, elsewhere);
+  report("kernel", &ktab, n, max);
+  report("user", &utab, n, max);
+  exit(0);
+}
@@ -0,0 +1,81 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+#include "kernel/bcachestat.h"
+#include "kernel/memlayout.h"
+#include "user/user.h"
+
+// measure how fast a large file streams from the disk: drop
+// the buffer cache, then read the file start to end, which
+// read-ahead should keep ahead of; then read it again from
+// the cache, for comparison.
+//
+//   readbench [KiB]
+
+#define CHUNK 4096
+
+char buf[CHUNK];
+
+void
+run(char *what, int size, int flags)
+{
+  struct bcachestat st;
+  int fd, n, tot, us;
+  uint64 t0;
+
+  bcachestat(&st, BCACHE_RESET | flags);
+  if((fd = open("readbench.tmp", O_RDONLY)) < 0){
+    fprintf(2, "readbench: open failed\n");
+    exit(1);
+  }
+  t0 = rdtime();
+  for(tot = 0; (n = read(fd, buf, CHUNK)) > 0; tot += n)
+    ;
+  us = (rdtime() - t0) / (TIMEFREQ / 1000000);
+  close(fd);
+  if(tot != size){
+    fprintf(2, "readbench: read %d of %d bytes\n", tot, size);
+    exit(1);
+  }
+  bcachestat(&st, 0);
+
+  if(us == 0)
+    us = 1;
+  printf("%s: %d KiB in %d us, %d KiB/s, %d cache misses\n", what,
+         size / 1024, us, (int)((uint64)size / 1024 * 1000000 / us),
+         (int)st.misses);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int kib = 256, size, fd, i, n;
+
+  if(argc > 1)
+    kib = atoi(argv[1]);
+  size = kib * 1024;
+  if(kib < 1 || size > MAXFILE*BSIZE){
+    fprintf(2, "usage: readbench [KiB], at most %d\n", MAXFILE*BSIZE/1024);
+    exit(1);
+  }
+
+  if((fd = open("readbench.tmp", O_CREATE|O_WRONLY|O_TRUNC)) < 0){
+    fprintf(2, "readbench: create failed\n");
+    exit(1);
+  }
+  memset(buf, 'r', sizeof(buf));
+  for(i = 0; i < size; i += n){
+    n = size - i < CHUNK ? size - i : CHUNK;
+    if(write(fd, buf, n) != n){
+      fprintf(2, "readbench: write failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+
+  run("disk", size, BCACHE_DROP);
+  run("cache", size, 0);
+  unlink("readbench.tmp");
+  exit(0);
+}
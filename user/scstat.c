@@ -0,0 +1,137 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/memlayout.h"
+#include "kernel/scstat.h"
+#include "user/user.h"
+
+// report per-system-call counts and times.
+//
+//   scstat                 counts since boot (or the last reset)
+//   scstat [-t mask] cmd   clear the counts, run cmd, and report
+//                          the calls made while it ran; -t also
+//                          traces the calls in mask made by cmd
+//                          and its children. mask is a number
+//                          (0x for hex) with bit 1 << SYS_* set
+//                          for each call, or a comma-separated
+//                          list of call names.
+
+#define NSC 64
+
+struct scstat st[NSC];
+
+// print the system calls that were made, most total time first.
+void
+report(int n)
+{
+  int i, best;
+  uint64 us = TIMEFREQ / 1000000;
+
+  printf("%s %s %s %s %s\n", "syscall", "calls", "total-us", "avg-us", "max-us");
+  for(;;){
+    best = -1;
+    for(i = 0; i < n; i++)
+      if(st[i].count && (best < 0 || st[i].time > st[best].time))
+        best = i;
+    if(best < 0)
+      break;
+    printf("%s %d %d %d %d\n",
+           st[best].name[0] ? st[best].name : "?",
+           (int)st[best].count, (int)(st[best].time / us),
+           (int)(st[best].time / us / st[best].count), (int)(st[best].max / us));
+    st[best].count = 0;
+  }
+}
+
+// Parse a -t mask, using the names of the n system calls
+// in st[]. Exits if s names an unknown call.
+uint64
+parsemask(char *s, int n)
+{
+  uint64 mask = 0;
+  int base = 10, d, i, len;
+
+  if(*s >= '0' && *s <= '9'){
+    if(s[0] == '0' && (s[1] == 'x' || s[1] == 'X')){
+      base = 16;
+      s += 2;
+    }
+    for(; *s; s++){
+      if(*s >= '0' && *s <= '9')
+        d = *s - '0';
+      else if(base == 16 && *s >= 'a' && *s <= 'f')
+        d = *s - 'a' + 10;
+      else if(base == 16 && *s >= 'A' && *s <= 'F')
+        d = *s - 'A' + 10;
+      else
+        break;
+      mask = mask * base + d;
+    }
+    if(*s == 0)
+      return mask;
+  } else {
+    while(*s){
+      len = strchr(s, ',') ? strchr(s, ',') - s : strlen(s);
+      for(i = 0; i < n; i++)
+        if(st[i].name[0] && strlen(st[i].name) == len && memcmp(st[i].name, s, len) == 0)
+          break;
+      if(i == n)
+        break;
+      mask |= 1UL << i;
+      s += len;
+      if(*s == ',')
+        s++;
+    }
+    if(*s == 0)
+      return mask;
+  }
+  fprintf(2, "scstat: bad mask at %s\n", s);
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint64 mask = 0;
+  char *maskarg = 0;
+  int n, pid;
+
+  if(argc > 2 && strcmp(argv[1], "-t") == 0){
+    maskarg = argv[2];
+    argv += 2;
+    argc -= 2;
+  }
+
+  if(argc < 2){
+    if((n = scstats(st, NSC, 0)) < 0){
+      fprintf(2, "scstat: scstats failed\n");
+      exit(1);
+    }
+    report(n < NSC ? n : NSC);
+    exit(0);
+  }
+
+  if((n = scstats(st, NSC, 1)) < 0){
+    fprintf(2, "scstat: scstats failed\n");
+    exit(1);
+  }
+  if(maskarg)
+    mask = parsemask(maskarg, n < NSC ? n : NSC);
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "scstat: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    trace(mask);
+    exec(argv[1], argv + 1);
+    fprintf(2, "scstat: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+  if((n = scstats(st, NSC, 0)) < 0){
+    fprintf(2, "scstat: scstats failed\n");
+    exit(1);
+  }
+  report(n < NSC ? n : NSC);
+  exit(0);
+}
@@ -1,8 +1,51 @@
+#include "kernel/param.h"
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "kernel/uring.h"
 #include "user/user.h"
 
+// getpid(), uptime(), get_cpu() and cpu_process_count() only
+// read kernel state, which the kernel publishes in the
+// read-only USYSCALL and USHARED pages; no need to trap.
+
+int
+getpid(void)
+{
+  return ((struct usyscall*)USYSCALL)->pid;
+}
+
+int
+uptime(void)
+{
+  return ((volatile struct ushared*)USHARED)->ticks;
+}
+
+int
+get_cpu(void)
+{
+  return ((volatile struct usyscall*)USYSCALL)->cpu;
+}
+
+int
+cpu_process_count(int cpu)
+{
+  if(cpu < 0 || cpu >= NCPU)
+    return -1;
+  return ((volatile struct ushared*)USHARED)->runq[cpu];
+}
+
+// read the real-time counter (TIMEFREQ ticks per second).
+uint64
+rdtime(void)
+{
+  uint64 x;
+  asm volatile("rdtime %0" : "=r" (x));
+  return x;
+}
+
 char*
 strcpy(char *s, const char *t)
 {
@@ -134,3 +177,41 @@ memcpy(void *dst, const void *src, uint n)
 {
   return memmove(dst, src, n);
 }
+
+// Queue system call num(a0, a1, a2) on ring r, to be run by
+// the next uring_enter(); its completion will carry data.
+// Returns 0, or -1 if the submission queue is full.
+int
+uring_queue(struct uring *r, int num, uint64 data, uint64 a0, uint64 a1, uint64 a2)
+{
+  struct uring_sqe *sqe;
+
+  if(r->sqtail - r->sqhead >= URING_N)
+    return -1;
+  sqe = &r->sq[r->sqtail % URING_N];
+  sqe->num = num;
+  sqe->data = data;
+  sqe->args[0] = a0;
+  sqe->args[1] = a1;
+  sqe->args[2] = a2;
+  __sync_synchronize();
+  r->sqtail++;
+  return 0;
+}
+
+// Take the oldest completion off ring r.
+// Returns 0, or -1 if there is none.
+int
+uring_reap(struct uring *r, uint64 *data, uint64 *ret)
+{
+  struct uring_cqe *cqe;
+
+  if(r->cqhead == r->cqtail)
+    return -1;
+  __sync_synchronize();
+  cqe = &r->cq[r->cqhead % URING_N];
+  *data = cqe->data;
+  *ret = cqe->ret;
+  r->cqhead++;
+  return 0;
+}
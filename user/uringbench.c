@@ -0,0 +1,57 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/syscall.h"
+#include "kernel/memlayout.h"
+#include "kernel/uring.h"
+#include "user/user.h"
+
+// compare the cost of NCALL fstat() calls made one trap at
+// a time with the same calls queued on a uring and run
+// batch at a time.
+
+#define NCALL 4096
+
+struct stat st;
+
+void
+report(char *what, int batch, uint64 dt)
+{
+  int us = dt / (TIMEFREQ / 1000000);
+
+  printf("%s %d: %d calls in %d us, %d ns/call\n",
+         what, batch, NCALL, us, (int)(dt * (1000000000 / TIMEFREQ) / NCALL));
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct uring *r;
+  uint64 t0, d, ret;
+  int i, j, batch;
+
+  t0 = rdtime();
+  for(i = 0; i < NCALL; i++)
+    fstat(0, &st);
+  report("trap", 1, rdtime() - t0);
+
+  if((r = uring_setup()) == (struct uring*)-1){
+    fprintf(2, "uringbench: uring_setup failed\n");
+    exit(1);
+  }
+  for(batch = 1; batch <= URING_N; batch *= 2){
+    t0 = rdtime();
+    for(i = 0; i < NCALL; i += batch){
+      for(j = 0; j < batch; j++)
+        uring_queue(r, SYS_fstat, j, 0, (uint64)&st, 0);
+      if(uring_enter(batch) != batch){
+        fprintf(2, "uringbench: uring_enter failed\n");
+        exit(1);
+      }
+      while(uring_reap(r, &d, &ret) == 0)
+        ;
+    }
+    report("uring", batch, rdtime() - t0);
+  }
+  exit(0);
+}
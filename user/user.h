@@ -1,5 +1,9 @@
 struct stat;
 struct rtcdate;
+struct uring;
+struct scstat;
+struct lockstat;
+struct bcachestat;
 
 // system calls
 int fork(void);
@@ -26,6 +30,18 @@ int uptime(void);
 int get_cpu(void);
 int set_cpu(int);
 int cpu_process_count(int);
+int kbench(int);
+int kmeminfo(int*, int);
+void* mmap(void*, uint64, int, int, int, int);
+int munmap(void*, int);
+struct uring* uring_setup(void);
+int uring_enter(int);
+int trace(uint64);
+int scstats(struct scstat*, int, int);
+int prof(int, void*, int);
+int lockstat(struct lockstat*, int, int);
+int lockbench(int, int, uint64*);
+int bcachestat(struct bcachestat*, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -43,3 +59,6 @@ void free(void*);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+uint64 rdtime(void);
+int uring_queue(struct uring*, int, uint64, uint64, uint64, uint64);
+int uring_reap(struct uring*, uint64*, uint64*);
@@ -7,6 +7,13 @@
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
+#include "kernel/uring.h"
+#include "kernel/scstat.h"
+#include "kernel/prof.h"
+#include "kernel/lockstat.h"
+#include "kernel/spinlock.h"
+#include "kernel/kbench.h"
+#include "kernel/bcachestat.h"
 
 //
 // Tests xv6 system calls.  usertests without arguments runs them all
@@ -107,6 +114,495 @@ copyout(char *s)
   }
 }
 
+// user addresses that are low enough for the kernel to reach
+// directly (UACCESSFLG=ON) but not mapped: just past the heap,
+// and far past it.
+void
+copyunmapped(char *s)
+{
+  uint64 addrs[2];
+  int fd, n;
+
+  addrs[0] = ((uint64)sbrk(0) + 2*4096) & ~4095L;
+  addrs[1] = 0x4000000LL;
+  for(int ai = 0; ai < 2; ai++){
+    uint64 addr = addrs[ai];
+
+    fd = open("README", 0);
+    if(fd < 0){
+      printf("%s: open(README) failed\n", s);
+      exit(1);
+    }
+    n = read(fd, (void*)addr, 100);
+    if(n >= 0){
+      printf("%s: read(fd, %p, 100) returned %d, not -1\n", s, addr, n);
+      exit(1);
+    }
+    close(fd);
+
+    fd = open("copyunmapped", O_CREATE|O_WRONLY);
+    if(fd < 0){
+      printf("%s: open(copyunmapped) failed\n", s);
+      exit(1);
+    }
+    n = write(fd, (void*)addr, 100);
+    if(n >= 0){
+      printf("%s: write(fd, %p, 100) returned %d, not -1\n", s, addr, n);
+      exit(1);
+    }
+    close(fd);
+    unlink("copyunmapped");
+
+    fd = open((char *)addr, O_CREATE|O_WRONLY);
+    if(fd >= 0){
+      printf("%s: open(%p) returned %d, not -1\n", s, addr, fd);
+      exit(1);
+    }
+  }
+}
+
+// getpid() and friends read the USYSCALL and USHARED pages
+// instead of trapping; check that what they find is current,
+// and that user code cannot write those pages.
+void
+usyscall(char *s)
+{
+  int pid, xstatus, fds[2];
+  int t0, n;
+  char c;
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    c = getpid();
+    write(fds[1], &c, 1);
+    exit(0);
+  }
+  if(read(fds[0], &c, 1) != 1 || c != (char)pid){
+    printf("%s: child's getpid() does not match fork()\n", s);
+    exit(1);
+  }
+  wait(&xstatus);
+  close(fds[0]);
+  close(fds[1]);
+
+  t0 = uptime();
+  sleep(2);
+  if(uptime() - t0 < 2){
+    printf("%s: uptime() did not advance\n", s);
+    exit(1);
+  }
+
+  n = get_cpu();
+  if(n < 0 || n >= NCPU){
+    printf("%s: get_cpu() returned %d\n", s, n);
+    exit(1);
+  }
+  if(cpu_process_count(NCPU) != -1){
+    printf("%s: cpu_process_count(NCPU) did not fail\n", s);
+    exit(1);
+  }
+
+  uint64 addrs[] = { USYSCALL, USHARED };
+  for(int ai = 0; ai < 2; ai++){
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      *(volatile int*)addrs[ai] = 99;
+      exit(0);
+    }
+    wait(&xstatus);
+    if(xstatus != -1){
+      printf("%s: write to %p did not fail\n", s, addrs[ai]);
+      exit(1);
+    }
+  }
+}
+
+// batch system calls through a uring: results come back in
+// order with their data, fork and exec cannot be queued, the
+// queue holds URING_N entries, and a child has no ring.
+void
+uring(char *s)
+{
+  struct uring *r;
+  int fds[2], pid, xstatus, i;
+  uint64 d, ret;
+  char buf[4];
+
+  if((r = uring_setup()) == (struct uring*)-1){
+    printf("%s: uring_setup failed\n", s);
+    exit(1);
+  }
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  uring_queue(r, SYS_write, 10, fds[1], (uint64)"abc", 3);
+  uring_queue(r, SYS_read, 11, fds[0], (uint64)buf, 3);
+  uring_queue(r, SYS_fork, 12, 0, 0, 0);
+  uring_queue(r, SYS_close, 13, 99, 0, 0);
+  uring_queue(r, SYS_getpid, 14, 0, 0, 0);
+  if(uring_enter(5) != 5){
+    printf("%s: uring_enter did not run 5 entries\n", s);
+    exit(1);
+  }
+  int want[] = { 3, 3, -1, -1, getpid() };
+  for(i = 0; i < 5; i++){
+    if(uring_reap(r, &d, &ret) < 0 || d != 10 + i || (int)ret != want[i]){
+      printf("%s: entry %d: data %d returned %d, want %d\n", s, i, (int)d, (int)ret, want[i]);
+      exit(1);
+    }
+  }
+  if(memcmp(buf, "abc", 3) != 0){
+    printf("%s: read through the ring got the wrong data\n", s);
+    exit(1);
+  }
+  if(uring_reap(r, &d, &ret) == 0){
+    printf("%s: too many completions\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+
+  for(i = 0; i < URING_N; i++){
+    if(uring_queue(r, SYS_getpid, i, 0, 0, 0) < 0){
+      printf("%s: queue full after %d entries\n", s, i);
+      exit(1);
+    }
+  }
+  if(uring_queue(r, SYS_getpid, i, 0, 0, 0) == 0){
+    printf("%s: queued more than URING_N entries\n", s);
+    exit(1);
+  }
+  if(uring_enter(URING_N) != URING_N){
+    printf("%s: uring_enter did not run a full queue\n", s);
+    exit(1);
+  }
+  for(i = 0; i < URING_N; i++)
+    uring_reap(r, &d, &ret);
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0)
+    exit(uring_enter(1) == -1 ? 0 : 1);
+  wait(&xstatus);
+  if(xstatus != 0){
+    printf("%s: child inherited the ring\n", s);
+    exit(1);
+  }
+}
+
+// scstats() counts every system call, including ones made
+// through a uring.
+void
+scstatcount(char *s)
+{
+  struct scstat st[SYS_scstats+1];
+  struct stat sb;
+  struct uring *r;
+  uint64 before, d, ret;
+  int i;
+
+  if(scstats(st, SYS_scstats+1, 0) < SYS_scstats+1){
+    printf("%s: scstats failed\n", s);
+    exit(1);
+  }
+  before = st[SYS_fstat].count;
+  for(i = 0; i < 10; i++)
+    fstat(1, &sb);
+  if((r = uring_setup()) == (struct uring*)-1){
+    printf("%s: uring_setup failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 5; i++)
+    uring_queue(r, SYS_fstat, i, 1, (uint64)&sb, 0);
+  uring_enter(5);
+  while(uring_reap(r, &d, &ret) == 0)
+    ;
+  scstats(st, SYS_scstats+1, 0);
+  // other processes may be calling fstat() too.
+  if(st[SYS_fstat].count < before + 15){
+    printf("%s: fstat count went from %d to %d\n", s,
+           (int)before, (int)st[SYS_fstat].count);
+    exit(1);
+  }
+  if(st[SYS_fstat].time < st[SYS_fstat].max){
+    printf("%s: bad fstat times\n", s);
+    exit(1);
+  }
+}
+
+// the profiler should catch this process spinning in user space.
+void
+profsamples(char *s)
+{
+  static struct profsample samples[NCPU*1024];
+  int i, n, t0, mine;
+
+  if(prof(PROF_START, 0, 0) < 0){
+    printf("%s: prof start failed\n", s);
+    exit(1);
+  }
+  t0 = uptime();
+  while(uptime() - t0 < 3)
+    ;
+  prof(PROF_STOP, 0, 0);
+  n = prof(PROF_READ, samples, NCPU*1024);
+  if(n <= 0){
+    printf("%s: no samples\n", s);
+    exit(1);
+  }
+  mine = 0;
+  for(i = 0; i < n; i++)
+    if(samples[i].pid == getpid() && samples[i].user && samples[i].pc < (uint64)sbrk(0))
+      mine++;
+  if(mine == 0){
+    printf("%s: %d samples, none of this process in user space\n", s, n);
+    exit(1);
+  }
+  if(prof(PROF_READ, samples, NCPU*1024) != 0){
+    printf("%s: samples were not removed by reading them\n", s);
+    exit(1);
+  }
+}
+
+// lockstat() reports locks by name; allocating memory
+// must show up as acquires of the kmem lock.
+void
+lockstatkmem(char *s)
+{
+  static struct lockstat st[64];
+  uint64 before = 0;
+  int i, n, k;
+
+  n = lockstat(st, 64, 0);
+  for(k = 0; k < n; k++)
+    if(strcmp(st[k].name, "kmem") == 0)
+      break;
+  if(k == n){
+    printf("%s: no kmem lock among %d\n", s, n);
+    exit(1);
+  }
+  before = st[k].nacquire;
+  for(i = 0; i < 10; i++)
+    sbrk(4096);
+  sbrk(-10*4096);
+  lockstat(st, 64, 0);
+  if(st[k].nacquire < before + 10 || st[k].ncontend > st[k].nacquire){
+    printf("%s: kmem acquires went from %d to %d\n", s,
+           (int)before, (int)st[k].nacquire);
+    exit(1);
+  }
+}
+
+// two processes contend for a kernel lock of each kind;
+// every acquire must be accounted for.
+void
+lockkinds(char *s)
+{
+  int kinds[] = { LOCK_TAS, LOCK_TICKET, LOCK_MCS };
+  uint64 hist[LOCKBENCH_NHIST], sum;
+  int k, i, b, pid, xstatus;
+
+  for(k = 0; k < 3; k++){
+    for(i = 0; i < 2; i++){
+      pid = fork();
+      if(pid < 0){
+        printf("%s: fork failed\n", s);
+        exit(1);
+      }
+      if(pid == 0){
+        memset(hist, 0, sizeof(hist));
+        if(lockbench(kinds[k], 5000, hist) < 0)
+          exit(1);
+        sum = 0;
+        for(b = 0; b < LOCKBENCH_NHIST; b++)
+          sum += hist[b];
+        exit(sum == 5000 ? 0 : 2);
+      }
+    }
+    for(i = 0; i < 2; i++){
+      wait(&xstatus);
+      if(xstatus != 0){
+        printf("%s: lockbench kind %d failed (%d)\n", s, kinds[k], xstatus);
+        exit(1);
+      }
+    }
+  }
+  if(lockbench(99, 1, hist) >= 0){
+    printf("%s: lockbench accepted a bad kind\n", s);
+    exit(1);
+  }
+}
+
+// the buffer cache holds a file much bigger than the old
+// fixed-size cache; reading it again should mostly hit.
+void
+bcachehits(char *s)
+{
+  struct bcachestat st;
+  char buf[BSIZE];
+  int fd, i, pass;
+
+  fd = open("bch", O_CREATE|O_WRONLY);
+  if(fd < 0){
+    printf("%s: create bch failed\n", s);
+    exit(1);
+  }
+  memset(buf, 'b', sizeof(buf));
+  for(i = 0; i < 100; i++){
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf("%s: write bch failed\n", s);
+      exit(1);
+    }
+  }
+  close(fd);
+
+  for(pass = 0; pass < 2; pass++){
+    if(bcachestat(&st, BCACHE_RESET) < 0){
+      printf("%s: bcachestat failed\n", s);
+      exit(1);
+    }
+    if((fd = open("bch", O_RDONLY)) < 0){
+      printf("%s: open bch failed\n", s);
+      exit(1);
+    }
+    for(i = 0; i < 100; i++){
+      if(read(fd, buf, sizeof(buf)) != sizeof(buf)){
+        printf("%s: read bch failed\n", s);
+        exit(1);
+      }
+    }
+    close(fd);
+  }
+  bcachestat(&st, 0);
+  unlink("bch");
+  if(st.hits < 100 || st.misses > 10 || st.nbuf < 100 || st.nbuf > st.maxbuf){
+    printf("%s: %d hits, %d misses, %d of %d buffers\n", s,
+           (int)st.hits, (int)st.misses, st.nbuf, st.maxbuf);
+    exit(1);
+  }
+}
+
+// read a file back from the disk, one block and then a few
+// bytes at a time, while read-ahead reads the blocks in
+// behind readi()'s back; every byte must be right.
+void
+readahead(char *s)
+{
+  struct bcachestat st;
+  char buf[BSIZE];
+  int fd, i, j, n;
+
+  fd = open("ra", O_CREATE|O_WRONLY);
+  if(fd < 0){
+    printf("%s: create ra failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 100; i++){
+    memset(buf, i, sizeof(buf));
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf("%s: write ra failed\n", s);
+      exit(1);
+    }
+  }
+  close(fd);
+
+  for(n = BSIZE; n > 0; n -= BSIZE - 7){
+    bcachestat(&st, BCACHE_DROP);
+    if((fd = open("ra", O_RDONLY)) < 0){
+      printf("%s: open ra failed\n", s);
+      exit(1);
+    }
+    for(i = 0; i + n <= 100*BSIZE; i += n){
+      if(read(fd, buf, n) != n){
+        printf("%s: read ra failed at %d\n", s, i);
+        exit(1);
+      }
+      for(j = 0; j < n; j++){
+        if(buf[j] != (char)((i + j) / BSIZE)){
+          printf("%s: wrong data at %d\n", s, i + j);
+          exit(1);
+        }
+      }
+    }
+    close(fd);
+  }
+  unlink("ra");
+}
+
+// grow two files a block at a time in turn, so that their
+// blocks alternate on disk (a window of pre-allocated blocks
+// at a time) and each file runs out of extents and continues
+// in its doubly-indirect block; then read them back. The
+// second round truncates and rewrites them.
+void
+extents(char *s)
+{
+  enum { N = 8*(NPREALLOC+1) };
+  char *names[] = { "ext0", "ext1" };
+  int fds[2], i, k, round;
+
+  for(round = 0; round < 2; round++){
+    for(k = 0; k < 2; k++){
+      fds[k] = open(names[k], O_CREATE|O_TRUNC|O_WRONLY);
+      if(fds[k] < 0){
+        printf("%s: create %s failed\n", s, names[k]);
+        exit(1);
+      }
+    }
+    for(i = 0; i < N; i++){
+      for(k = 0; k < 2; k++){
+        memset(buf, 'a' + k + i, BSIZE);
+        if(write(fds[k], buf, BSIZE) != BSIZE){
+          printf("%s: write %s failed\n", s, names[k]);
+          exit(1);
+        }
+      }
+    }
+    close(fds[0]);
+    close(fds[1]);
+
+    for(k = 0; k < 2; k++){
+      if((fds[k] = open(names[k], O_RDONLY)) < 0){
+        printf("%s: open %s failed\n", s, names[k]);
+        exit(1);
+      }
+      for(i = 0; i < N; i++){
+        if(read(fds[k], buf, BSIZE) != BSIZE){
+          printf("%s: read %s failed\n", s, names[k]);
+          exit(1);
+        }
+        if(buf[0] != (char)('a' + k + i) || buf[BSIZE-1] != buf[0]){
+          printf("%s: wrong data in block %d of %s\n", s, i, names[k]);
+          exit(1);
+        }
+      }
+      if(read(fds[k], buf, 1) != 0){
+        printf("%s: %s too long\n", s, names[k]);
+        exit(1);
+      }
+      close(fds[k]);
+    }
+  }
+  unlink(names[0]);
+  unlink(names[1]);
+}
+
 // what if you pass ridiculous string pointers to system calls?
 void
 copyinstr1(char *s)
@@ -572,6 +1068,9 @@ writetest(char *s)
 void
 writebig(char *s)
 {
+  // more blocks than direct and indirect blocks used to
+  // allow, without filling the disk.
+  enum { N = 400 };
   int i, fd, n;
 
   fd = open("big", O_CREATE|O_RDWR);
@@ -580,7 +1079,7 @@ writebig(char *s)
     exit(1);
   }
 
-  for(i = 0; i < MAXFILE; i++){
+  for(i = 0; i < N; i++){
     ((int*)buf)[0] = i;
     if(write(fd, buf, BSIZE) != BSIZE){
       printf("%s: error: write big file failed\n", s, i);
@@ -600,7 +1099,7 @@ writebig(char *s)
   for(;;){
     i = read(fd, buf, BSIZE);
     if(i == 0){
-      if(n == MAXFILE - 1){
+      if(n != N){
         printf("%s: read only %d blocks from big", s, n);
         exit(1);
       }
@@ -1080,6 +1579,386 @@ mem(char *s)
   }
 }
 
+// count the free pages held in blocks of at least
+// 2^minorder physically contiguous pages.
+int
+freeabove(int minorder)
+{
+  int nfree[MAXORDER+1];
+  int k, n;
+
+  if(kmeminfo(nfree, MAXORDER+1) != MAXORDER+1){
+    printf("kmeminfo failed\n");
+    exit(1);
+  }
+  n = 0;
+  for(k = minorder; k <= MAXORDER; k++)
+    n += nfree[k] << k;
+  return n;
+}
+
+// fork/exit churn with differently sized children must not
+// fragment physical memory: once the children are gone, the
+// buddy allocator should have coalesced their pages back
+// into large blocks.
+void
+buddychurn(char *s)
+{
+  int big0, big1, i, j, pid, xstatus;
+
+  big0 = freeabove(6);
+  for(i = 0; i < 8; i++){
+    for(j = 0; j < 4; j++){
+      pid = fork();
+      if(pid < 0){
+        printf("%s: fork failed\n", s);
+        exit(1);
+      }
+      if(pid == 0){
+        // 2 MiB plus an odd number of pages, so that the
+        // children's pages interleave in physical memory.
+        if(sbrk(2*1024*1024 + (i*4 + j)*3*4096) == (char*)0xffffffffffffffffL){
+          printf("%s: sbrk failed\n", s);
+          exit(1);
+        }
+        exit(0);
+      }
+    }
+    for(j = 0; j < 4; j++){
+      wait(&xstatus);
+      if(xstatus != 0)
+        exit(1);
+    }
+  }
+  big1 = freeabove(6);
+
+  // allow for the pre-zeroed page pool refilling itself
+  // from large blocks while the test runs.
+  if(big1 + 512 < big0){
+    printf("%s: %d pages in large free blocks before, %d after\n",
+           s, big0, big1);
+    exit(1);
+  }
+}
+
+// more processes holding open pipes than the kernel used to
+// have room for (100 files), all at the same time: the file
+// and pipe tables must grow on demand.
+void
+manypipes(char *s)
+{
+  enum { NCHILD = 10, NPIPE = 7 };
+  int ready[2], hold[2], fds[2];
+  int i, j, pid, xstatus;
+  char c;
+
+  if(pipe(ready) < 0 || pipe(hold) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < NCHILD; i++){
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      close(ready[0]);
+      close(hold[1]);
+      for(j = 0; j < NPIPE; j++){
+        if(pipe(fds) < 0){
+          printf("%s: pipe %d in child %d failed\n", s, j, i);
+          write(ready[1], "x", 1);
+          exit(1);
+        }
+      }
+      write(ready[1], "x", 1);
+      // keep the pipes open until the parent says go.
+      read(hold[0], &c, 1);
+      exit(0);
+    }
+  }
+  close(ready[1]);
+  close(hold[0]);
+  for(i = 0; i < NCHILD; i++){
+    if(read(ready[0], &c, 1) != 1)
+      break;
+  }
+  close(hold[1]);
+  close(ready[0]);
+  for(i = 0; i < NCHILD; i++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(1);
+  }
+}
+
+// create a file of n bytes, byte i being 'a' + i%23.
+static void
+mkpattern(char *s, char *name, int n)
+{
+  char buf[512];
+  int fd, i, m;
+
+  fd = open(name, O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: cannot create %s\n", s, name);
+    exit(1);
+  }
+  for(i = 0; i < n; i += m){
+    m = n - i < sizeof(buf) ? n - i : sizeof(buf);
+    for(int j = 0; j < m; j++)
+      buf[j] = 'a' + (i+j) % 23;
+    if(write(fd, buf, m) != m){
+      printf("%s: write %s failed\n", s, name);
+      exit(1);
+    }
+  }
+  close(fd);
+}
+
+// mmap a file privately and shared; check that faults read
+// the right data, that only shared stores reach the file,
+// that munmap can trim a region, and that fork copies
+// mapped pages.
+void
+mmaptest(char *s)
+{
+  enum { SZ = 3*4096 + 100 };
+  char *p, c;
+  int fd, i, pid, xstatus;
+
+  mkpattern(s, "mmap.f", SZ);
+
+  // private: stores stay in this process.
+  fd = open("mmap.f", O_RDONLY);
+  p = mmap(0, SZ, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if(p == (char*)-1){
+    printf("%s: mmap private failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  for(i = 0; i < SZ; i++){
+    if(p[i] != 'a' + i % 23){
+      printf("%s: private byte %d is %d\n", s, i, p[i]);
+      exit(1);
+    }
+  }
+  // past EOF, the last page reads as zeros.
+  if(p[SZ] != 0){
+    printf("%s: byte past EOF is %d\n", s, p[SZ]);
+    exit(1);
+  }
+  p[0] = 'Z';
+  if(munmap(p, SZ) < 0){
+    printf("%s: munmap private failed\n", s);
+    exit(1);
+  }
+  fd = open("mmap.f", O_RDONLY);
+  if(read(fd, &c, 1) != 1 || c != 'a'){
+    printf("%s: private store reached the file\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  // a shared, writable mapping needs a writable fd.
+  fd = open("mmap.f", O_RDONLY);
+  if(mmap(0, SZ, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0) != (char*)-1){
+    printf("%s: mmap shared writable of read-only fd succeeded\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  // shared: stores are written back on munmap.
+  fd = open("mmap.f", O_RDWR);
+  p = mmap(0, SZ, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if(p == (char*)-1){
+    printf("%s: mmap shared failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  p[1] = 'Y';
+  p[2*4096] = 'X';
+
+  // the child gets a copy of the mapping, and its stores
+  // reach the file when it exits.
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    if(p[1] != 'Y' || p[2*4096] != 'X')
+      exit(1);
+    p[3*4096] = 'W';
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0){
+    printf("%s: child did not see parent's stores\n", s);
+    exit(1);
+  }
+
+  // drop the first page, then the rest.
+  if(munmap(p, 4096) < 0 || munmap(p + 4096, SZ - 4096) < 0){
+    printf("%s: munmap shared failed\n", s);
+    exit(1);
+  }
+  if(munmap(p, 4096) == 0){
+    printf("%s: munmap of unmapped page succeeded\n", s);
+    exit(1);
+  }
+
+  fd = open("mmap.f", O_RDONLY);
+  for(i = 0; i < SZ; i++){
+    if(read(fd, &c, 1) != 1){
+      printf("%s: short file\n", s);
+      exit(1);
+    }
+    if(i == 1 ? c != 'Y' : i == 2*4096 ? c != 'X' : i == 3*4096 ? c != 'W' :
+       c != 'a' + i % 23){
+      printf("%s: file byte %d is %d after munmap\n", s, i, c);
+      exit(1);
+    }
+  }
+  if(read(fd, &c, 1) != 0){
+    printf("%s: munmap grew the file\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("mmap.f");
+}
+
+// a region may not reach down into the heap.
+void
+mmapheap(char *s)
+{
+  uint64 heap = PGROUNDUP((uint64)sbrk(0));
+  int fd;
+
+  fd = open("README", O_RDONLY);
+  if(fd < 0){
+    printf("%s: open README failed\n", s);
+    exit(1);
+  }
+  if(mmap(0, MMAPTOP, PROT_READ, MAP_PRIVATE, fd, 0) != (char*)-1){
+    printf("%s: mmap over text and heap succeeded\n", s);
+    exit(1);
+  }
+  if(mmap(0, MMAPTOP - heap + 4096, PROT_READ, MAP_PRIVATE, fd, 0) != (char*)-1){
+    printf("%s: mmap over the top of the heap succeeded\n", s);
+    exit(1);
+  }
+  close(fd);
+}
+
+// read() into and write() from mmap()ed memory.
+void
+mmapcopy(char *s)
+{
+  enum { SZ = 2*4096 };
+  char *p, *q;
+  int fd, i;
+
+  mkpattern(s, "mmapcp.f", SZ);
+  fd = open("mmapcp.f", O_RDWR);
+  p = mmap(0, SZ, PROT_READ, MAP_PRIVATE, fd, 0);
+  q = mmap(0, SZ, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if(p == (char*)-1 || q == (char*)-1){
+    printf("%s: mmap failed\n", s);
+    exit(1);
+  }
+
+  // a read() into a read-only mapping must fail.
+  if(read(fd, p, 10) >= 0){
+    printf("%s: read into PROT_READ mapping succeeded\n", s);
+    exit(1);
+  }
+
+  // fault in the private copy before the file changes under it.
+  for(i = 0; i < SZ; i += 4096)
+    if(p[i] != 'a' + i % 23){
+      printf("%s: byte %d wrong\n", s, i);
+      exit(1);
+    }
+
+  // and it must still fail now that the pages are present.
+  if(read(fd, p, 10) >= 0){
+    printf("%s: read into faulted-in PROT_READ mapping succeeded\n", s);
+    exit(1);
+  }
+
+  // write() the private copy back over the start of the file,
+  // reversed, through the kernel's copyin().
+  for(i = 0; i < SZ; i++)
+    if(write(fd, p + SZ - 1 - i, 1) != 1){
+      printf("%s: write from mapping failed\n", s);
+      exit(1);
+    }
+
+  // read() into the shared mapping, through copyout().
+  close(fd);
+  fd = open("mmapcp.f", O_RDONLY);
+  if(read(fd, q, SZ) != SZ){
+    printf("%s: read into mapping failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  munmap(p, SZ);
+  munmap(q, SZ);
+
+  fd = open("mmapcp.f", O_RDONLY);
+  for(i = 0; i < SZ; i++){
+    char c;
+    if(read(fd, &c, 1) != 1 || c != 'a' + (SZ - 1 - i) % 23){
+      printf("%s: byte %d wrong\n", s, i);
+      exit(1);
+    }
+  }
+  close(fd);
+  unlink("mmapcp.f");
+}
+
+// the kernel caches translations for copyout(); they must not
+// outlive the pages they point to.
+void
+staletlb(char *s)
+{
+  char *a, *b;
+  int fd;
+
+  fd = open("staletlb", O_CREATE|O_RDWR);
+  if(fd < 0 || write(fd, "0123456789", 10) != 10){
+    printf("%s: cannot create staletlb\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  fd = open("staletlb", O_RDONLY);
+  a = sbrk(4096);
+  if(read(fd, a, 4) != 4 || a[0] != '0'){
+    printf("%s: read into new page failed\n", s);
+    exit(1);
+  }
+  sbrk(-4096);
+  if(read(fd, a, 3) != -1){
+    printf("%s: read into freed page succeeded\n", s);
+    exit(1);
+  }
+  b = sbrk(4096);
+  if(b != a){
+    printf("%s: sbrk moved\n", s);
+    exit(1);
+  }
+  if(read(fd, b, 3) != 3 || b[0] != '4'){
+    printf("%s: read into re-grown page failed\n", s);
+    exit(1);
+  }
+  sbrk(-4096);
+  close(fd);
+  unlink("staletlb");
+}
+
 // More file system tests
 
 // two processes write to the same file descriptor
@@ -1382,6 +2261,80 @@ linktest(char *s)
   }
 }
 
+// path name lookups share directory locks; look up names
+// in one directory from several processes while another
+// process adds and removes entries there.
+void
+sharedlookup(char *s)
+{
+  char name[16];
+  int fd, i, pid, xstatus, nchild = 4;
+
+  if(mkdir("sl") != 0){
+    printf("%s: mkdir sl failed\n", s);
+    exit(1);
+  }
+  fd = open("sl/f", O_CREATE|O_WRONLY);
+  if(fd < 0){
+    printf("%s: create sl/f failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  for(i = 0; i < nchild; i++){
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      for(int j = 0; j < 200; j++){
+        if(i == 0){
+          // the writer.
+          name[0] = 's'; name[1] = 'l'; name[2] = '/';
+          name[3] = 'a' + j % 26; name[4] = '\0';
+          if((fd = open(name, O_CREATE|O_WRONLY)) < 0){
+            printf("%s: create %s failed\n", s, name);
+            exit(1);
+          }
+          close(fd);
+          if(j % 2 && unlink(name) != 0){
+            printf("%s: unlink %s failed\n", s, name);
+            exit(1);
+          }
+        } else {
+          if((fd = open("sl/f", O_RDONLY)) < 0){
+            printf("%s: open sl/f failed\n", s);
+            exit(1);
+          }
+          close(fd);
+          if(open("sl/nonexistent", O_RDONLY) >= 0){
+            printf("%s: open sl/nonexistent succeeded\n", s);
+            exit(1);
+          }
+        }
+      }
+      exit(0);
+    }
+  }
+  for(i = 0; i < nchild; i++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(1);
+  }
+
+  for(i = 0; i < 26; i++){
+    name[0] = 's'; name[1] = 'l'; name[2] = '/';
+    name[3] = 'a' + i; name[4] = '\0';
+    unlink(name);
+  }
+  unlink("sl/f");
+  if(unlink("sl") != 0){
+    printf("%s: unlink sl failed\n", s);
+    exit(1);
+  }
+}
+
 // test concurrent create/link/unlink of the same file
 void
 concreate(char *s)
@@ -2506,6 +3459,38 @@ stacktest(char *s)
     exit(xstatus);
 }
 
+// read() and write() must not reach the stack guard page,
+// though the kernel copies to and from user memory directly.
+void
+stackguard(char *s)
+{
+  char *guard = (char*)(PGROUNDDOWN(r_sp()) - PGSIZE);
+  int fd;
+
+  fd = open("README", O_RDONLY);
+  if(fd < 0){
+    printf("%s: open README failed\n", s);
+    exit(1);
+  }
+  if(read(fd, guard, 10) != -1){
+    printf("%s: read into guard page %p did not fail\n", s, guard);
+    exit(1);
+  }
+  close(fd);
+
+  fd = open("stackguard", O_CREATE|O_WRONLY);
+  if(fd < 0){
+    printf("%s: create stackguard failed\n", s);
+    exit(1);
+  }
+  if(write(fd, guard, 10) != -1){
+    printf("%s: write from guard page %p did not fail\n", s, guard);
+    exit(1);
+  }
+  close(fd);
+  unlink("stackguard");
+}
+
 // regression test. copyin(), copyout(), and copyinstr() used to cast
 // the virtual page address to uint, which (with certain wild system
 // call arguments) resulted in a kernel page faults.
@@ -2822,6 +3807,16 @@ main(int argc, char *argv[])
     {copyin, "copyin"},
     {copyout, "copyout"},
     {copyinstr1, "copyinstr1"},
+    {copyunmapped, "copyunmapped"},
+    {usyscall, "usyscall"},
+    {uring, "uring"},
+    {scstatcount, "scstatcount"},
+    {profsamples, "profsamples"},
+    {lockstatkmem, "lockstatkmem"},
+    {lockkinds, "lockkinds"},
+    {bcachehits, "bcachehits"},
+    {readahead, "readahead"},
+    {extents, "extents"},
     {copyinstr2, "copyinstr2"},
     {copyinstr3, "copyinstr3"},
     {rwsbrk, "rwsbrk" },
@@ -2843,6 +3838,7 @@ main(int argc, char *argv[])
     {linktest, "linktest"},
     {unlinkread, "unlinkread"},
     {concreate, "concreate"},
+    {sharedlookup, "sharedlookup"},
     {subdir, "subdir"},
     {fourfiles, "fourfiles"},
     {sharedfd, "sharedfd"},
@@ -2860,6 +3856,7 @@ main(int argc, char *argv[])
     {sbrk8000, "sbrk8000"},
     {validatetest, "validatetest"},
     {stacktest, "stacktest"},
+    {stackguard, "stackguard"},
     {opentest, "opentest"},
     {writetest, "writetest"},
     {writebig, "writebig"},
@@ -2868,6 +3865,12 @@ main(int argc, char *argv[])
     {exitiputtest, "exitiput"},
     {iputtest, "iput"},
     {mem, "mem"},
+    {buddychurn, "buddychurn"},
+    {manypipes, "manypipes"},
+    {mmaptest, "mmaptest"},
+    {mmapheap, "mmapheap"},
+    {mmapcopy, "mmapcopy"},
+    {staletlb, "staletlb"},
     {pipe1, "pipe1"},
     {killstatus, "killstatus"},
     {preempt, "preempt"},
@@ -32,10 +32,18 @@ entry("link");
 entry("mkdir");
 entry("chdir");
 entry("dup");
-entry("getpid");
 entry("sbrk");
 entry("sleep");
-entry("uptime");
-entry("get_cpu");
 entry("set_cpu");
-entry("cpu_process_count");
+entry("kbench");
+entry("kmeminfo");
+entry("mmap");
+entry("munmap");
+entry("uring_setup");
+entry("uring_enter");
+entry("trace");
+entry("scstats");
+entry("prof");
+entry("lockstat");
+entry("lockbench");
+entry("bcachestat");